@@ -91,14 +91,7 @@ struct AARasterExample : public R2DExampleApp {
         context.set_raster(&raster);
         context.set_source(&source);
 
-        R2DColor8* pixel_data = (R2DColor8*)image_sm.raw_data();
-        for (uint32_t y = 0; y < image_sm.height(); y++) {
-            for (uint32_t x = 0; x < image_sm.width(); x++) {
-                source.solid = pixel_data[y * image_sm.width() + x];
-                context.draw_rect_filled(x * pixel_size_f, y * pixel_size_f, pixel_size_f,
-                                         pixel_size_f);
-            }
-        }
+        r2d_blit_scaled_nearest(out_image, image_sm, pixel_size);
 
         context.set_source(&source2);
         context.set_line_thickness(1.0f);
@@ -20,9 +20,20 @@ int R2DExampleApp::run() {
     on_init();
 
     SDL_Surface* surface = SDL_GetWindowSurface(window);
+    // Draw straight into the window surface if its pixel format is supported, otherwise draw
+    // into an image that is converted into the surface every frame
+    R2DPixelFormat surface_format = r2d_sdl2_surface_format(surface->format);
+    bool draw_to_surface = surface_format != R2DPixelFormat::Unknown;
     R2DImage image;
-    image.init(width_, height_, R2DPixelFormat::RGBA8);
-    image.clear(R2DColor(0, 0, 0));
+    if (draw_to_surface) {
+        SDL_LockSurface(surface);
+        image.wrap(surface->pixels, surface->w, surface->h, surface_format, surface->pitch);
+        image.clear(R2DColor(0, 0, 0));
+        SDL_UnlockSurface(surface);
+    } else {
+        image.init(width_, height_, R2DPixelFormat::RGBA8);
+        image.clear(R2DColor(0, 0, 0));
+    }
     on_resize(width_, height_);
 
     running_ = true;
@@ -56,10 +67,18 @@ int R2DExampleApp::run() {
             }
         }
 
-        on_draw(image);
-        SDL_LockSurface(surface);
-        r2d_sdl2_render_blit_image(surface, image, true);
-        SDL_UnlockSurface(surface);
+        if (draw_to_surface) {
+            // The pixels may move while the surface is unlocked
+            SDL_LockSurface(surface);
+            image.wrap(surface->pixels, surface->w, surface->h, surface_format, surface->pitch);
+            on_draw(image);
+            SDL_UnlockSurface(surface);
+        } else {
+            on_draw(image);
+            SDL_LockSurface(surface);
+            r2d_sdl2_render_blit_image(surface, image, true);
+            SDL_UnlockSurface(surface);
+        }
         SDL_UpdateWindowSurface(window);
     }
 
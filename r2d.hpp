@@ -4,6 +4,7 @@
 #include <cassert>
 #include <cmath>
 #include <d2d1helper.h>
+#include <type_traits>
 
 enum class R2DPixelFormat {
     Unknown,
@@ -11,7 +12,20 @@ enum class R2DPixelFormat {
     ARGB8,
     BGRA8,
     RGBX8,
-    BGRX8
+    BGRX8,
+    A8,      // Alpha only, 1 byte per pixel
+    RGB565,  // 5-6-5 bit opaque color, 2 bytes per pixel
+    RGBA32F, // Premultiplied float RGBA, 16 bytes per pixel
+    NV12,    // BT.601 limited range YUV 4:2:0, a luma plane followed by interleaved UV samples of
+             // 2x2 pixel blocks. Only composited with SrcOver, SrcCopy and Clear.
+};
+
+// Alpha conversion done by the pixel format converters. RGBA32F pixels are premultiplied, they
+// are read and written as premultiplied 8-bit colors before the conversion is applied.
+enum class R2DAlphaConversion {
+    None,
+    Premultiply,
+    Unpremultiply,
 };
 
 enum class R2DBlendMode {
@@ -27,11 +41,33 @@ enum class R2DBlendMode {
     DstCopy,
     Clear,
     Xor,
+    Multiply,
+    Screen,
+    Overlay,
+    Darken,
+    Lighten,
+    Difference,
 };
 
 enum class R2DSourceType {
     Solid,
-    Linear
+    Linear,
+    Radial,
+    Conic,
+    Pattern,
+};
+
+// How a gradient or a pattern is extended outside of its definition range
+enum class R2DExtendMode {
+    Pad,
+    Repeat,
+    Reflect,
+};
+
+// Sampling filter of image patterns
+enum class R2DPatternFilter {
+    Nearest,
+    Bilinear,
 };
 
 enum class R2DFillMode {
@@ -53,6 +89,15 @@ enum class R2DPathCommand {
     CubicTo,
 };
 
+// Classification of a transformation matrix, from the cheapest to the most expensive
+enum class R2DTransformType {
+    Identity,  // No transformation
+    Translate, // Translation only
+    Scale,     // Axis-aligned scaling and translation
+    Rotate,    // Rotation with uniform scaling and translation
+    General,   // Any other affine transformation
+};
+
 enum class R2DContextFlags {
     Blending, // Enable/disable color blending between render target and the incoming source color
               // values. (default: enabled)
@@ -60,8 +105,17 @@ enum class R2DContextFlags {
     LazyClear,             // Enable/disable render target lazy clear. (default: disabled)
     PremultipliedDstAlpha, // Render target color is alpha-premultiplied. (default:
                            // disabled)
+    Dithering,             // Enable/disable ordered dithering on RGB565 render targets.
+                           // (default: disabled)
+    LinearBlending, // Blend in linear light instead of on sRGB encoded values, only used by
+                    // 32-bit render targets. (default: disabled)
 };
 
+R2D_FORCEINLINE
+static constexpr uint32_t r2d_context_flag(R2DContextFlags flag) noexcept {
+    return 1u << (uint32_t)flag;
+}
+
 struct R2DPoint {
     float x;
     float y;
@@ -126,12 +180,72 @@ static constexpr R2DColorBitShift r2d_color_bitshift(R2DPixelFormat format) noex
             return {8, 16, 24, 0};
         case R2DPixelFormat::BGRA8:
             return {16, 8, 0, 24};
+        case R2DPixelFormat::RGBX8:
+            return {0, 8, 16, 24};
+        case R2DPixelFormat::BGRX8:
+            return {16, 8, 0, 24};
         default:
             R2D_UNREACHABLE();
     }
     return {};
 }
 
+// pshuflw/pshufhw/shufps control that moves channels in RGBA order into the order of a 32-bit
+// format
+R2D_FORCEINLINE
+static constexpr int r2d_format_swizzle_control(R2DPixelFormat format) noexcept {
+    R2DColorBitShift bitpos = r2d_color_bitshift(format);
+    return (int)(0 << (bitpos.r / 4) | 1 << (bitpos.g / 4) | 2 << (bitpos.b / 4) |
+                 3 << (bitpos.a / 4));
+}
+
+// Size of a pixel in bytes, the luma plane only for NV12
+R2D_FORCEINLINE
+static constexpr uint32_t r2d_format_bytes_per_pixel(R2DPixelFormat format) noexcept {
+    switch (format) {
+        case R2DPixelFormat::A8:
+        case R2DPixelFormat::NV12:
+            return 1;
+        case R2DPixelFormat::RGB565:
+            return 2;
+        case R2DPixelFormat::RGBA32F:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+// Returns false for formats without an alpha channel. The unused byte of these formats is at the
+// alpha position of r2d_color_bitshift(), it is ignored on read and set to 255 on write.
+R2D_FORCEINLINE
+static constexpr bool r2d_format_has_alpha(R2DPixelFormat format) noexcept {
+    return format != R2DPixelFormat::RGBX8 && format != R2DPixelFormat::BGRX8 &&
+           format != R2DPixelFormat::RGB565 && format != R2DPixelFormat::NV12;
+}
+
+// Size of the UV plane of an NV12 image in samples, odd sizes are rounded up
+R2D_FORCEINLINE
+static constexpr uint32_t r2d_chroma_size(uint32_t size) noexcept {
+    return (size + 1) >> 1;
+}
+
+// Size of the pixel data of a tightly packed image in bytes
+R2D_FORCEINLINE
+static constexpr size_t r2d_format_image_size(R2DPixelFormat format, uint32_t width,
+                                              uint32_t height) noexcept {
+    size_t size = (size_t)width * height * r2d_format_bytes_per_pixel(format);
+    if (format == R2DPixelFormat::NV12)
+        size += (size_t)r2d_chroma_size(width) * r2d_chroma_size(height) * 2;
+    return size;
+}
+
+// Convert a box into 24.8 fixed-point coordinates
+R2D_FORCEINLINE
+static R2DFixedBox r2d_fixed_box(const R2DBox& box) noexcept {
+    return R2DFixedBox{r2d_iround(box.x0 * 256.0f), r2d_iround(box.y0 * 256.0f),
+                       r2d_iround(box.x1 * 256.0f), r2d_iround(box.y1 * 256.0f)};
+}
+
 struct R2DColor {
     float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
 
@@ -186,6 +300,10 @@ struct R2DColor {
                 return R2D_COLOR_CHANNEL_4(u_r, u_g, u_b, 255);
             case R2DPixelFormat::BGRX8:
                 return R2D_COLOR_CHANNEL_4(u_b, u_g, u_r, 255);
+            case R2DPixelFormat::A8:
+                return u_a;
+            case R2DPixelFormat::RGB565:
+                return r2d_pack_rgb565(R2D_COLOR_CHANNEL_4(u_r, u_g, u_b, 255));
             default:
                 R2D_UNREACHABLE();
         }
@@ -208,7 +326,11 @@ struct R2DMatrix {
 
     inline R2DMatrix(const R2DMatrix&) noexcept = default;
 
-    inline R2DMatrix(R2DMatrix&&) = delete;
+    inline R2DMatrix(R2DMatrix&&) noexcept = default;
+
+    inline R2DMatrix& operator=(const R2DMatrix&) noexcept = default;
+
+    inline R2DMatrix& operator=(R2DMatrix&&) noexcept = default;
 
 #define AT(row, col) (row * 3 + col)
 
@@ -419,121 +541,1688 @@ struct R2DMatrix {
 #undef AT
 };
 
-struct R2DSourceLinear {};
+// Classify a 2x3 affine matrix stored in row-major order
+R2D_FORCEINLINE
+static R2DTransformType r2d_classify_transform(const float* m) noexcept {
+    if (m[1] != 0.0f || m[3] != 0.0f) {
+        if (m[0] == m[4] && m[1] == -m[3])
+            return R2DTransformType::Rotate;
+        return R2DTransformType::General;
+    }
+    if (m[0] != 1.0f || m[4] != 1.0f)
+        return R2DTransformType::Scale;
+    if (m[2] != 0.0f || m[5] != 0.0f)
+        return R2DTransformType::Translate;
+    return R2DTransformType::Identity;
+}
+
+// 2x3 affine transformation matrix. Only stores the first two rows of R2DMatrix, the last row is
+// always (0, 0, 1). The transformation type is tracked along with the coefficients so that
+// composition, inversion and the vertex kernels can take a shortcut for the common cases.
+struct R2DAffine {
+    float m[6]{1.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+    R2DTransformType type{};
+
+    constexpr R2DAffine() noexcept {}
+
+    R2DAffine(float m00, float m01, float m02, float m10, float m11, float m12) noexcept :
+        m{m00, m01, m02, m10, m11, m12}, type(r2d_classify_transform(m)) {}
+
+    explicit R2DAffine(const R2DMatrix& matrix) noexcept :
+        R2DAffine(matrix.m[0], matrix.m[1], matrix.m[2], matrix.m[3], matrix.m[4], matrix.m[5]) {}
+
+    R2DMatrix to_matrix() const noexcept {
+        return R2DMatrix(m[0], m[1], m[2], m[3], m[4], m[5], 0.0f, 0.0f, 1.0f);
+    }
+
+    R2D_FORCEINLINE bool is_identity() const noexcept { return type == R2DTransformType::Identity; }
+
+    // Returns true if axis-aligned rectangles stay axis-aligned
+    R2D_FORCEINLINE bool is_axis_aligned() const noexcept {
+        return type <= R2DTransformType::Scale;
+    }
+
+    R2D_FORCEINLINE float determinant() const noexcept { return m[0] * m[4] - m[1] * m[3]; }
+
+    R2D_FORCEINLINE R2DPoint transform(const R2DPoint& p) const noexcept {
+        switch (type) {
+            case R2DTransformType::Identity:
+                return p;
+            case R2DTransformType::Translate:
+                return R2DPoint{p.x + m[2], p.y + m[5]};
+            case R2DTransformType::Scale:
+                return R2DPoint{p.x * m[0] + m[2], p.y * m[4] + m[5]};
+            default:
+                return R2DPoint{m[0] * p.x + m[1] * p.y + m[2], m[3] * p.x + m[4] * p.y + m[5]};
+        }
+    }
+
+    // Compose two transformations, `other` is applied first
+    R2DAffine operator*(const R2DAffine& other) const noexcept {
+        if (other.type == R2DTransformType::Identity)
+            return *this;
+        if (type == R2DTransformType::Identity)
+            return other;
+
+        R2DAffine result;
+        if (type == R2DTransformType::Translate && other.type == R2DTransformType::Translate) {
+            result.m[2] = m[2] + other.m[2];
+            result.m[5] = m[5] + other.m[5];
+            result.type = R2DTransformType::Translate;
+            return result;
+        }
+
+        result.m[0] = m[0] * other.m[0] + m[1] * other.m[3];
+        result.m[1] = m[0] * other.m[1] + m[1] * other.m[4];
+        result.m[2] = m[0] * other.m[2] + m[1] * other.m[5] + m[2];
+        result.m[3] = m[3] * other.m[0] + m[4] * other.m[3];
+        result.m[4] = m[3] * other.m[1] + m[4] * other.m[4];
+        result.m[5] = m[3] * other.m[2] + m[4] * other.m[5] + m[5];
+        result.type = r2d_classify_transform(result.m);
+        return result;
+    }
+
+    R2DAffine& operator*=(const R2DAffine& other) noexcept { return *this = *this * other; }
+
+    // Compute the inverse transformation. Returns false if the matrix is singular.
+    bool invert(R2DAffine& out) const noexcept {
+        switch (type) {
+            case R2DTransformType::Identity:
+                out = R2DAffine();
+                return true;
+            case R2DTransformType::Translate:
+                out = R2DAffine();
+                out.m[2] = -m[2];
+                out.m[5] = -m[5];
+                out.type = R2DTransformType::Translate;
+                return true;
+            case R2DTransformType::Scale: {
+                if (m[0] == 0.0f || m[4] == 0.0f)
+                    return false;
+                float inv_sx = 1.0f / m[0];
+                float inv_sy = 1.0f / m[4];
+                out = R2DAffine(inv_sx, 0.0f, -m[2] * inv_sx, 0.0f, inv_sy, -m[5] * inv_sy);
+                return true;
+            }
+            default: {
+                float det = determinant();
+                if (det == 0.0f)
+                    return false;
+                float inv_det = 1.0f / det;
+                float a = m[4] * inv_det;
+                float b = -m[1] * inv_det;
+                float c = -m[3] * inv_det;
+                float d = m[0] * inv_det;
+                out = R2DAffine(a, b, -(a * m[2] + b * m[5]), c, d, -(c * m[2] + d * m[5]));
+                return true;
+            }
+        }
+    }
+
+    inline static R2DAffine identity() noexcept { return R2DAffine(); }
+
+    inline static R2DAffine translate(float x, float y) noexcept {
+        return R2DAffine(1.0f, 0.0f, x, 0.0f, 1.0f, y);
+    }
+
+    inline static R2DAffine scale(float sx, float sy) noexcept {
+        return R2DAffine(sx, 0.0f, 0.0f, 0.0f, sy, 0.0f);
+    }
+
+    inline static R2DAffine scale(float s) noexcept { return scale(s, s); }
+
+    inline static R2DAffine rotate(float rad_angle) noexcept {
+        float s = std::sin(rad_angle);
+        float c = std::cos(rad_angle);
+        return R2DAffine(c, -s, 0.0f, s, c, 0.0f);
+    }
+
+    inline static R2DAffine shear(float x, float y) noexcept {
+        return R2DAffine(1.0f, x, 0.0f, y, 1.0f, 0.0f);
+    }
+};
+
+R2D_FORCEINLINE
+static R2DPoint r2d_transform_point(const R2DPoint& p, const R2DAffine& m) noexcept {
+    return R2DPoint{m.m[0] * p.x + m.m[1] * p.y + m.m[2], m.m[3] * p.x + m.m[4] * p.y + m.m[5]};
+}
+
+// Transform `count` points with `m`. Two points are transformed per SSE
+// register. `dst` and `src` may be the same array.
+static void r2d_transform_points(R2DPoint* dst, const R2DPoint* src, size_t count,
+                                 const R2DAffine& m) noexcept {
+    __m128 m_x = _mm_setr_ps(m.m[0], m.m[3], m.m[0], m.m[3]);
+    __m128 m_y = _mm_setr_ps(m.m[1], m.m[4], m.m[1], m.m[4]);
+    __m128 m_t = _mm_setr_ps(m.m[2], m.m[5], m.m[2], m.m[5]);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128 p = _mm_loadu_ps(&src[i].x);
+        __m128 xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, m_x), _mm_mul_ps(yy, m_y)), m_t);
+        _mm_storeu_ps(&dst[i].x, r);
+    }
+    if (i < count) {
+        dst[i] = r2d_transform_point(src[i], m);
+    }
+}
+
+// Translation-only variant of r2d_transform_points
+static void r2d_translate_points(R2DPoint* dst, const R2DPoint* src, size_t count, float tx,
+                                 float ty) noexcept {
+    __m128 t = _mm_setr_ps(tx, ty, tx, ty);
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        _mm_storeu_ps(&dst[i].x, _mm_add_ps(_mm_loadu_ps(&src[i].x), t));
+    }
+    if (i < count) {
+        dst[i] = R2DPoint{src[i].x + tx, src[i].y + ty};
+    }
+}
+
+// Transform `count` points and convert them into 24.8 fixed-point coordinates. The fixed-point
+// scale is folded into the matrix so the conversion costs a single cvtps2dq per two points.
+static void r2d_transform_points_fixed(R2DFixed32* dst, const R2DPoint* src, size_t count,
+                                       const R2DAffine& m) noexcept {
+    __m128 m_x = _mm_mul_ps(_mm_setr_ps(m.m[0], m.m[3], m.m[0], m.m[3]), _mm_set1_ps(256.0f));
+    __m128 m_y = _mm_mul_ps(_mm_setr_ps(m.m[1], m.m[4], m.m[1], m.m[4]), _mm_set1_ps(256.0f));
+    __m128 m_t = _mm_mul_ps(_mm_setr_ps(m.m[2], m.m[5], m.m[2], m.m[5]), _mm_set1_ps(256.0f));
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        __m128 p = _mm_loadu_ps(&src[i].x);
+        __m128 xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+        __m128 yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+        __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, m_x), _mm_mul_ps(yy, m_y)), m_t);
+        _mm_storeu_si128((__m128i*)(dst + i * 2), _mm_cvtps_epi32(r));
+    }
+    if (i < count) {
+        R2DPoint p = r2d_transform_point(src[i], m);
+        dst[i * 2 + 0] = r2d_iround(p.x * 256.0f);
+        dst[i * 2 + 1] = r2d_iround(p.y * 256.0f);
+    }
+}
+
+struct R2DGradientStop {
+    float offset;
+    R2DColor8 color; // RGBA8
+};
+
+// Color stops of a gradient. The stops are baked into a color lookup table which is cached here
+// and only rebuilt after the stops have been changed.
+struct R2DGradient {
+    static constexpr uint32_t lut_size = 256;
+
+    R2DVector<R2DGradientStop> stops_;
+    R2DExtendMode extend_mode_{};
+    bool lut_dirty_ = true;
+    R2DColor8 lut_[lut_size]{};
+
+    R2DGradient() {}
+
+    R2DGradient(R2DExtendMode extend_mode) : extend_mode_(extend_mode) {}
+
+    // Add a color stop. Stops are kept sorted by their offset, stops with the same offset keep
+    // their insertion order so they can be used to make a hard transition.
+    void add_stop(float offset, R2DColor8 color) {
+        offset = r2d_clamp(offset, 0.0f, 1.0f);
+        size_t pos = stops_.size();
+        stops_.push_back(R2DGradientStop{offset, color});
+        while (pos > 0 && stops_[pos - 1].offset > offset) {
+            stops_[pos] = stops_[pos - 1];
+            pos--;
+        }
+        stops_[pos] = R2DGradientStop{offset, color};
+        lut_dirty_ = true;
+    }
+
+    void add_stop(float offset, const R2DColor& color) { add_stop(offset, color.to_rgba8()); }
+
+    void clear_stops() noexcept {
+        stops_.clear();
+        lut_dirty_ = true;
+    }
+
+    void set_extend_mode(R2DExtendMode extend_mode) noexcept { extend_mode_ = extend_mode; }
+
+    R2DExtendMode extend_mode() const noexcept { return extend_mode_; }
+
+    const R2DColor8* lut() noexcept {
+        if (lut_dirty_)
+            build_lut();
+        return lut_;
+    }
+
+    // Bake the stops into the lookup table. The colors are interpolated with premultiplied alpha
+    // so transparent stops do not bleed their color into the neighbouring stops.
+    void build_lut() noexcept {
+        lut_dirty_ = false;
+        if (stops_.empty()) {
+            std::memset(lut_, 0, sizeof(lut_));
+            return;
+        }
+
+        size_t stop = 0;
+        for (uint32_t i = 0; i < lut_size; i++) {
+            // The fetchers index with floor(t * lut_size), so sample each entry at its center
+            float t = ((float)i + 0.5f) / (float)lut_size;
+            while (stop + 1 < stops_.size() && stops_[stop + 1].offset < t) {
+                stop++;
+            }
+
+            const R2DGradientStop& s0 = stops_[stop];
+            const R2DGradientStop& s1 = stops_[r2d_min(stop + 1, stops_.size() - 1)];
+            float range = s1.offset - s0.offset;
+            float f = range > 0.0f ? r2d_clamp((t - s0.offset) / range, 0.0f, 1.0f) : 0.0f;
+            if (t < s0.offset)
+                f = 0.0f;
+
+            float a0 = (float)(s0.color >> 24);
+            float a1 = (float)(s1.color >> 24);
+            float a = a0 + (a1 - a0) * f;
+            R2DColor8 color = 0;
+            if (a > 0.0f) {
+                for (uint32_t shift = 0; shift < 24; shift += 8) {
+                    float c0 = (float)((s0.color >> shift) & 0xFF) * a0;
+                    float c1 = (float)((s1.color >> shift) & 0xFF) * a1;
+                    uint32_t c = (uint32_t)r2d_iround((c0 + (c1 - c0) * f) / a);
+                    color |= r2d_min(c, 255u) << shift;
+                }
+                color |= (uint32_t)r2d_iround(a) << 24;
+            }
+            lut_[i] = color;
+        }
+    }
+};
+
+// Linear gradient between `p0` (offset 0) and `p1` (offset 1). The points are in user space and
+// are transformed with the context transformation.
+struct R2DSourceLinear {
+    R2DPoint p0;
+    R2DPoint p1;
+    R2DGradient* gradient;
+};
+
+// Two-point radial gradient. The gradient is made of circles interpolated from the start circle
+// (c0, r0) at offset 0 to the end circle (c1, r1) at offset 1. Setting c0 == c1 and r0 == 0 gives
+// a simple radial gradient.
+struct R2DSourceRadial {
+    R2DPoint c0;
+    float r0;
+    R2DPoint c1;
+    float r1;
+    R2DGradient* gradient;
+};
+
+// Conic (sweep) gradient around `center`. Offset 0 starts at `angle` (in radians) and the
+// offsets increase clockwise in device space, a full turn ends at offset 1.
+struct R2DSourceConic {
+    R2DPoint center;
+    float angle;
+    R2DGradient* gradient;
+};
+
+struct R2DImage;
+
+// Image pattern. `transform` maps the image space into the user space, a null transform places
+// the image at the user space origin. Both extend modes apply outside of the image bounds.
+struct R2DSourcePattern {
+    const R2DImage* image;
+    const R2DAffine* transform;
+    R2DExtendMode extend_mode;
+    R2DPatternFilter filter;
+};
 
 struct R2DSource {
     R2DSourceType type;
     union {
         R2DColor8 solid;
         R2DSourceLinear linear;
+        R2DSourceRadial radial;
+        R2DSourceConic conic;
+        R2DSourcePattern pattern;
     };
 };
 
+R2D_FORCEINLINE
+static void r2d_gather_lut4(R2DColor8* dst, const R2DColor8* lut, __m128i index) noexcept {
+    dst[0] = lut[_mm_extract_epi16(index, 0)];
+    dst[1] = lut[_mm_extract_epi16(index, 2)];
+    dst[2] = lut[_mm_extract_epi16(index, 4)];
+    dst[3] = lut[_mm_extract_epi16(index, 6)];
+}
+
+// Convert gradient positions (in lookup table units) into lookup table indices
+template <R2DExtendMode ExtendMode>
+R2D_FORCEINLINE static __m128i r2d_gradient_index4(__m128 t) noexcept {
+    static constexpr float max_index = (float)(R2DGradient::lut_size - 1);
+    if constexpr (ExtendMode == R2DExtendMode::Pad) {
+        t = _mm_min_ps(_mm_max_ps(t, _mm_setzero_ps()), _mm_set1_ps(max_index));
+        return _mm_cvttps_epi32(t);
+    }
+
+    // floor(t), out of range values wrap around which is fine for a periodic gradient
+    __m128i index = _mm_cvttps_epi32(t);
+    index = _mm_add_epi32(index, _mm_castps_si128(_mm_cmplt_ps(t, _mm_cvtepi32_ps(index))));
+    if constexpr (ExtendMode == R2DExtendMode::Repeat) {
+        return _mm_and_si128(index, _mm_set1_epi32(R2DGradient::lut_size - 1));
+    } else {
+        // Mirror every odd period
+        __m128i odd = _mm_srai_epi32(_mm_slli_epi32(index, 23), 31);
+        index = _mm_xor_si128(index, odd);
+        return _mm_and_si128(index, _mm_set1_epi32(R2DGradient::lut_size - 1));
+    }
+}
+
+// Fetches linear gradient colors, the gradient position is an affine function of the device
+// pixel position: t = a * x + b * y + c.
+struct R2DFetchLinear {
+    float a;
+    float b;
+    float c;
+    const R2DColor8* lut;
+    R2DExtendMode extend_mode;
+
+    R2DFetchLinear(const R2DSourceLinear& linear, const R2DAffine& inv_transform) noexcept {
+        R2DPoint d = linear.p1 - linear.p0;
+        float len_sq = d.length_sq();
+        float inv_len = len_sq > 0.0f ? (float)R2DGradient::lut_size / len_sq : 0.0f;
+        const float* m = inv_transform.m;
+        a = (d.x * m[0] + d.y * m[3]) * inv_len;
+        b = (d.x * m[1] + d.y * m[4]) * inv_len;
+        c = (d.x * (m[2] - linear.p0.x) + d.y * (m[5] - linear.p0.y)) * inv_len;
+        lut = linear.gradient->lut();
+        extend_mode = linear.gradient->extend_mode();
+    }
+
+    void fetch(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        switch (extend_mode) {
+            case R2DExtendMode::Pad:
+                fetch_span<R2DExtendMode::Pad>(dst, x, y, count);
+                break;
+            case R2DExtendMode::Repeat:
+                fetch_span<R2DExtendMode::Repeat>(dst, x, y, count);
+                break;
+            case R2DExtendMode::Reflect:
+                fetch_span<R2DExtendMode::Reflect>(dst, x, y, count);
+                break;
+        }
+    }
+
+    // Four pixels are evaluated at a time by stepping the gradient position incrementally
+    template <R2DExtendMode ExtendMode>
+    R2D_FORCEINLINE void fetch_span(R2DColor8* dst, int32_t x, int32_t y,
+                                    uint32_t count) const noexcept {
+        float t0 = a * ((float)x + 0.5f) + b * ((float)y + 0.5f) + c;
+        __m128 t = _mm_add_ps(_mm_set1_ps(t0), _mm_mul_ps(_mm_setr_ps(0, 1, 2, 3), _mm_set1_ps(a)));
+        __m128 dt = _mm_set1_ps(a * 4.0f);
+        uint32_t i = 0;
+
+        for (; i + 4 <= count; i += 4) {
+            r2d_gather_lut4(dst + i, lut, r2d_gradient_index4<ExtendMode>(t));
+            t = _mm_add_ps(t, dt);
+        }
+
+        if (i < count) {
+            R2DColor8 tail[4];
+            r2d_gather_lut4(tail, lut, r2d_gradient_index4<ExtendMode>(t));
+            for (uint32_t j = 0; i < count; i++, j++) {
+                dst[i] = tail[j];
+            }
+        }
+    }
+};
+
+// Fetches two-point radial gradient colors. For each pixel the largest `t` is searched such that
+// the pixel lies on the circle (c0 + t * (c1 - c0), r0 + t * (r1 - r0)) with a non-negative radius.
+// This is a quadratic equation in `t` which is solved for four pixels at a time.
+struct R2DFetchRadial {
+    float pdx;     // Pixel position relative to c0 in the gradient space at device (0, 0)
+    float pdy;     //
+    float pdx_dx;  // Increment of the pixel position per device pixel in the x direction
+    float pdy_dx;  //
+    float pdx_dy;  // Increment of the pixel position per device pixel in the y direction
+    float pdy_dy;  //
+    float cdx;     // c1 - c0
+    float cdy;     //
+    float r0;      //
+    float dr;      // r1 - r0
+    float a;       // cd.cd - dr^2
+    float inv_a;   //
+    const R2DColor8* lut;
+    R2DExtendMode extend_mode;
+
+    R2DFetchRadial(const R2DSourceRadial& radial, const R2DAffine& inv_transform) noexcept {
+        const float* m = inv_transform.m;
+        pdx = m[2] - radial.c0.x;
+        pdy = m[5] - radial.c0.y;
+        pdx_dx = m[0];
+        pdy_dx = m[3];
+        pdx_dy = m[1];
+        pdy_dy = m[4];
+        cdx = radial.c1.x - radial.c0.x;
+        cdy = radial.c1.y - radial.c0.y;
+        r0 = radial.r0;
+        dr = radial.r1 - radial.r0;
+        a = cdx * cdx + cdy * cdy - dr * dr;
+        inv_a = a != 0.0f ? 1.0f / a : 0.0f;
+        lut = radial.gradient->lut();
+        extend_mode = radial.gradient->extend_mode();
+    }
+
+    void fetch(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        switch (extend_mode) {
+            case R2DExtendMode::Pad:
+                fetch_span<R2DExtendMode::Pad>(dst, x, y, count);
+                break;
+            case R2DExtendMode::Repeat:
+                fetch_span<R2DExtendMode::Repeat>(dst, x, y, count);
+                break;
+            case R2DExtendMode::Reflect:
+                fetch_span<R2DExtendMode::Reflect>(dst, x, y, count);
+                break;
+        }
+    }
+
+    // Returns the gradient position of four pixels, `valid` is cleared for pixels that are not
+    // covered by the gradient
+    R2D_FORCEINLINE __m128 solve4(__m128 px, __m128 py, __m128& valid) const noexcept {
+        __m128 v_r0 = _mm_set1_ps(r0);
+        __m128 v_dr = _mm_set1_ps(dr);
+        __m128 zero = _mm_setzero_ps();
+        __m128 b = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(cdx)),
+                                         _mm_mul_ps(py, _mm_set1_ps(cdy))),
+                              _mm_set1_ps(r0 * dr));
+        __m128 c = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(px, px), _mm_mul_ps(py, py)),
+                              _mm_set1_ps(r0 * r0));
+
+        if (a == 0.0f) {
+            // The equation is linear: 2bt = c
+            __m128 t = _mm_div_ps(c, _mm_mul_ps(b, _mm_set1_ps(2.0f)));
+            __m128 r = _mm_add_ps(v_r0, _mm_mul_ps(t, v_dr));
+            valid = _mm_and_ps(_mm_cmpneq_ps(b, zero), _mm_cmpge_ps(r, zero));
+            return _mm_and_ps(valid, t);
+        }
+
+        __m128 disc = _mm_sub_ps(_mm_mul_ps(b, b), _mm_mul_ps(_mm_set1_ps(a), c));
+        __m128 sq = _mm_sqrt_ps(_mm_max_ps(disc, zero));
+        __m128 t0 = _mm_mul_ps(_mm_add_ps(b, sq), _mm_set1_ps(inv_a));
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(b, sq), _mm_set1_ps(inv_a));
+        __m128 t_max = _mm_max_ps(t0, t1);
+        __m128 t_min = _mm_min_ps(t0, t1);
+        __m128 max_valid = _mm_cmpge_ps(_mm_add_ps(v_r0, _mm_mul_ps(t_max, v_dr)), zero);
+        __m128 min_valid = _mm_cmpge_ps(_mm_add_ps(v_r0, _mm_mul_ps(t_min, v_dr)), zero);
+        valid = _mm_and_ps(_mm_cmpge_ps(disc, zero), _mm_or_ps(max_valid, min_valid));
+        return _mm_and_ps(valid, r2d_select_ps(max_valid, t_max, t_min));
+    }
+
+    template <R2DExtendMode ExtendMode>
+    R2D_FORCEINLINE void fetch_span(R2DColor8* dst, int32_t x, int32_t y,
+                                    uint32_t count) const noexcept {
+        float fx = (float)x + 0.5f;
+        float fy = (float)y + 0.5f;
+        __m128 steps = _mm_setr_ps(0, 1, 2, 3);
+        __m128 px = _mm_add_ps(_mm_set1_ps(pdx + pdx_dx * fx + pdx_dy * fy),
+                               _mm_mul_ps(steps, _mm_set1_ps(pdx_dx)));
+        __m128 py = _mm_add_ps(_mm_set1_ps(pdy + pdy_dx * fx + pdy_dy * fy),
+                               _mm_mul_ps(steps, _mm_set1_ps(pdy_dx)));
+        __m128 step_x = _mm_set1_ps(pdx_dx * 4.0f);
+        __m128 step_y = _mm_set1_ps(pdy_dx * 4.0f);
+        __m128 lut_scale = _mm_set1_ps((float)R2DGradient::lut_size);
+
+        for (uint32_t i = 0; i < count; i += 4) {
+            __m128 valid;
+            __m128 t = _mm_mul_ps(solve4(px, py, valid), lut_scale);
+            R2DColor8 colors[4];
+            r2d_gather_lut4(colors, lut, r2d_gradient_index4<ExtendMode>(t));
+            __m128i result = _mm_and_si128(_mm_loadu_si128((const __m128i*)colors),
+                                           _mm_castps_si128(valid));
+            if (count - i >= 4) {
+                _mm_storeu_si128((__m128i*)(dst + i), result);
+            } else {
+                _mm_storeu_si128((__m128i*)colors, result);
+                for (uint32_t j = 0; i + j < count; j++) {
+                    dst[i + j] = colors[j];
+                }
+            }
+            px = _mm_add_ps(px, step_x);
+            py = _mm_add_ps(py, step_y);
+        }
+    }
+};
+
+// Fetches conic gradient colors, the gradient position is the angle of the pixel around the
+// center computed with a vectorized atan2 approximation
+struct R2DFetchConic {
+    float px0;
+    float py0;
+    float px_dx;
+    float py_dx;
+    float px_dy;
+    float py_dy;
+    float angle;
+    const R2DColor8* lut;
+
+    R2DFetchConic(const R2DSourceConic& conic, const R2DAffine& inv_transform) noexcept {
+        const float* m = inv_transform.m;
+        px0 = m[2] - conic.center.x;
+        py0 = m[5] - conic.center.y;
+        px_dx = m[0];
+        py_dx = m[3];
+        px_dy = m[1];
+        py_dy = m[4];
+        angle = conic.angle;
+        lut = conic.gradient->lut();
+    }
+
+    void fetch(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        static constexpr float inv_two_pi = 0.15915494309f;
+        float fx = (float)x + 0.5f;
+        float fy = (float)y + 0.5f;
+        __m128 steps = _mm_setr_ps(0, 1, 2, 3);
+        __m128 px = _mm_add_ps(_mm_set1_ps(px0 + px_dx * fx + px_dy * fy),
+                               _mm_mul_ps(steps, _mm_set1_ps(px_dx)));
+        __m128 py = _mm_add_ps(_mm_set1_ps(py0 + py_dx * fx + py_dy * fy),
+                               _mm_mul_ps(steps, _mm_set1_ps(py_dx)));
+        __m128 step_x = _mm_set1_ps(px_dx * 4.0f);
+        __m128 step_y = _mm_set1_ps(py_dx * 4.0f);
+        __m128 lut_scale = _mm_set1_ps((float)R2DGradient::lut_size * inv_two_pi);
+        __m128 offset = _mm_set1_ps(-angle * (float)R2DGradient::lut_size * inv_two_pi);
+
+        for (uint32_t i = 0; i < count; i += 4) {
+            __m128 t = _mm_add_ps(_mm_mul_ps(r2d_atan2_ps(py, px), lut_scale), offset);
+            __m128i index = r2d_gradient_index4<R2DExtendMode::Repeat>(t);
+            if (count - i >= 4) {
+                r2d_gather_lut4(dst + i, lut, index);
+            } else {
+                R2DColor8 colors[4];
+                r2d_gather_lut4(colors, lut, index);
+                for (uint32_t j = 0; i + j < count; j++) {
+                    dst[i + j] = colors[j];
+                }
+            }
+            px = _mm_add_ps(px, step_x);
+            py = _mm_add_ps(py, step_y);
+        }
+    }
+};
+
 struct R2DImage {
     void* data_{};
     R2DPixelFormat format_{};
     uint32_t width_{};
     uint32_t height_{};
-    bool unmanaged_{};
+    size_t stride_{};        // Bytes between rows, the luma rows of NV12 images
+    void* chroma_data_{};    // UV plane of NV12 images
+    size_t chroma_stride_{}; // Bytes between UV rows of NV12 images
+    bool unmanaged_{};       // The pixels are owned by someone else, e.g. views and wrapped memory
 
     R2DImage() noexcept {}
 
     R2DImage(R2DImage&& image) noexcept :
-        data_(image.data_), format_(image.format_), width_(image.width_), height_(image.height_) {
+        data_(image.data_), format_(image.format_), width_(image.width_), height_(image.height_),
+        stride_(image.stride_), chroma_data_(image.chroma_data_),
+        chroma_stride_(image.chroma_stride_), unmanaged_(image.unmanaged_) {
         std::memset(&image, 0, sizeof(R2DImage));
     }
 
-    ~R2DImage() {
-        if (data_)
-            std::free(data_);
-        std::memset(this, 0, sizeof(R2DImage));
-    }
+    ~R2DImage() { reset(); }
 
     R2DImage& operator=(R2DImage&& image) noexcept {
+        if (this == &image)
+            return *this;
+        reset();
         data_ = std::exchange(image.data_, nullptr);
         format_ = std::exchange(image.format_, {});
         width_ = std::exchange(image.width_, 0);
         height_ = std::exchange(image.height_, 0);
+        stride_ = std::exchange(image.stride_, 0);
+        chroma_data_ = std::exchange(image.chroma_data_, nullptr);
+        chroma_stride_ = std::exchange(image.chroma_stride_, 0);
+        unmanaged_ = std::exchange(image.unmanaged_, false);
         return *this;
     }
 
     bool init(uint32_t width, uint32_t height, R2DPixelFormat format) {
         assert(width != 0);
         assert(height != 0);
-        size_t size = width * height * sizeof(R2DPixel);
+        size_t size = r2d_format_image_size(format, width, height);
         void* new_data = std::malloc(size);
         if (!new_data)
             return false;
-        if (data_)
-            std::free(data_);
+        reset();
         std::memset(new_data, 0, size);
-        data_ = new_data;
+        set_layout(new_data, width, height, format, 0, nullptr, 0);
+        return true;
+    }
+
+    // Use pixels owned by the caller, e.g. a locked window surface or a mapped staging buffer.
+    // The memory must outlive the image. `stride` defaults to tightly packed rows, the UV plane
+    // of NV12 images defaults to following the luma plane.
+    void wrap(void* data, uint32_t width, uint32_t height, R2DPixelFormat format,
+              size_t stride = 0, void* chroma_data = nullptr, size_t chroma_stride = 0) noexcept {
+        assert(data != nullptr);
+        assert(stride == 0 || stride % r2d_format_bytes_per_pixel(format) == 0);
+        reset();
+        set_layout(data, width, height, format, stride, chroma_data, chroma_stride);
+        unmanaged_ = true;
+    }
+
+    // A view of a rectangle of the image which shares its pixels, rendering into the view
+    // renders into the image. The rectangle is clipped to the image, NV12 views must start at
+    // even coordinates. The view must not outlive the image.
+    R2DImage view(uint32_t x, uint32_t y, uint32_t width, uint32_t height) const noexcept {
+        R2DImage image;
+        if (x >= width_ || y >= height_ || width == 0 || height == 0)
+            return image;
+        image.data_ = row(y) + (size_t)x * r2d_format_bytes_per_pixel(format_);
+        image.format_ = format_;
+        image.width_ = r2d_min(width, width_ - x);
+        image.height_ = r2d_min(height, height_ - y);
+        image.stride_ = stride_;
+        if (format_ == R2DPixelFormat::NV12) {
+            assert((x & 1) == 0 && (y & 1) == 0);
+            image.chroma_data_ = chroma_row(y >> 1) + (size_t)x;
+            image.chroma_stride_ = chroma_stride_;
+        }
+        image.unmanaged_ = true;
+        return image;
+    }
+
+    // Free the pixels if the image owns them
+    void reset() noexcept {
+        if (data_ && !unmanaged_)
+            std::free(data_);
+        std::memset(this, 0, sizeof(R2DImage));
+    }
+
+    void set_layout(void* data, uint32_t width, uint32_t height, R2DPixelFormat format,
+                    size_t stride, void* chroma_data, size_t chroma_stride) noexcept {
+        data_ = data;
         format_ = format;
         width_ = width;
         height_ = height;
-        return true;
+        stride_ = stride ? stride : (size_t)width * r2d_format_bytes_per_pixel(format);
+        if (format == R2DPixelFormat::NV12) {
+            chroma_data_ = chroma_data ? chroma_data : (uint8_t*)data + stride_ * height;
+            size_t packed_chroma_stride = (size_t)r2d_chroma_size(width) * 2;
+            chroma_stride_ = chroma_stride ? chroma_stride : r2d_max(stride_, packed_chroma_stride);
+        }
+    }
+
+    inline void clear(const R2DColor& color) noexcept {
+        if (format_ == R2DPixelFormat::RGBA32F) {
+            clear_float(r2d_premultiply_ps(_mm_setr_ps(color.r, color.g, color.b, color.a)));
+            return;
+        }
+        if (format_ == R2DPixelFormat::NV12) {
+            clear_raw(color.to_rgba8());
+            return;
+        }
+        clear_raw(color.to_bytes(format_));
+    }
+
+    // `color` is a pixel value in the image format, the low byte for A8 images and the low 16
+    // bits for RGB565 images. Float images take a straight RGBA8 color, NV12 images an RGB color.
+    void clear_raw(R2DColor8 color, uint32_t thread_count = 1) {
+        fill_raw(0, 0, width_, height_, color, thread_count);
+    }
+
+    // Fill a rectangle with a pixel value, see clear_raw(). The rectangle is clipped to the
+    // image, chroma samples of NV12 images that are partly inside it are replaced too.
+    void fill_raw(uint32_t x, uint32_t y, uint32_t width, uint32_t height, R2DColor8 color,
+                  uint32_t thread_count = 1) {
+        if (x >= width_ || y >= height_)
+            return;
+        width = r2d_min(width, width_ - x);
+        height = r2d_min(height, height_ - y);
+
+        __m128i pattern;
+        switch (format_) {
+            case R2DPixelFormat::A8:
+                pattern = _mm_set1_epi8((char)color);
+                break;
+            case R2DPixelFormat::RGB565:
+                pattern = _mm_set1_epi16((short)color);
+                break;
+            case R2DPixelFormat::RGBA32F:
+                fill_float(x, y, width, height, r2d_premultiply_ps(r2d_color_to_ps(color)),
+                           thread_count);
+                return;
+            case R2DPixelFormat::NV12: {
+                R2DColor8 yuv = r2d_rgb_to_yuv(color);
+                r2d_fill_pixels(row(y) + x, stride_, width, height, _mm_set1_epi8((char)yuv),
+                                thread_count);
+                uint32_t chroma_x0 = x >> 1;
+                uint32_t chroma_y0 = y >> 1;
+                uint32_t chroma_width = ((x + width + 1) >> 1) - chroma_x0;
+                uint32_t chroma_height = ((y + height + 1) >> 1) - chroma_y0;
+                r2d_fill_pixels(chroma_row(chroma_y0) + chroma_x0 * 2, chroma_stride_,
+                                (size_t)chroma_width * 2, chroma_height,
+                                _mm_set1_epi16((short)(yuv >> 8)), thread_count);
+                return;
+            }
+            default:
+                pattern = _mm_set1_epi32((int)color);
+                break;
+        }
+        uint32_t bpp = r2d_format_bytes_per_pixel(format_);
+        r2d_fill_pixels(row(y) + (size_t)x * bpp, stride_, (size_t)width * bpp, height, pattern,
+                        thread_count);
     }
 
-    inline void clear(const R2DColor& color) noexcept { clear_raw(color.to_bytes(format_)); }
+    // Fill a float image with a premultiplied color
+    void clear_float(__m128 color, uint32_t thread_count = 1) {
+        fill_float(0, 0, width_, height_, color, thread_count);
+    }
 
-    void clear_raw(R2DColor8 color) noexcept {
-        r2d_clear_image((R2DColor8*)data_, width_, height_, color);
+    void fill_float(uint32_t x, uint32_t y, uint32_t width, uint32_t height, __m128 color,
+                    uint32_t thread_count = 1) {
+        assert(format_ == R2DPixelFormat::RGBA32F);
+        if (x >= width_ || y >= height_)
+            return;
+        width = r2d_min(width, width_ - x);
+        height = r2d_min(height, height_ - y);
+        r2d_fill_pixels(row(y) + (size_t)x * 16, stride_, (size_t)width * 16, height,
+                        _mm_castps_si128(color), thread_count);
     }
 
+    // Copy the image into a new tightly packed image which owns its pixels
     R2DImage clone() const {
         R2DImage new_image;
-        new_image.init(width_, height_, format_);
-        R2D_CHECK(std::memcpy(new_image.data_, data_, width_ * height_ * sizeof(R2DPixel)));
+        if (!new_image.init(width_, height_, format_))
+            return new_image;
+        size_t row_size = (size_t)width_ * r2d_format_bytes_per_pixel(format_);
+        r2d_copy_rows(new_image.row(0), new_image.stride_, row(0), stride_, row_size, height_);
+        if (format_ == R2DPixelFormat::NV12)
+            r2d_copy_rows(new_image.chroma_row(0), new_image.chroma_stride_, chroma_row(0),
+                          chroma_stride_, (size_t)r2d_chroma_size(width_) * 2,
+                          r2d_chroma_size(height_));
         return new_image;
     }
 
     R2DPixelFormat format() const { return format_; }
     uint32_t width() const { return width_; }
     uint32_t height() const { return height_; }
+    size_t stride() const { return stride_; }
     R2DRect rect() const noexcept { return R2DRect{0.0f, 0.0f, (float)width_, (float)height_}; }
     void* raw_data() const { return data_; }
-    operator bool() const noexcept { return data_ != nullptr; }
-};
+    bool is_view() const { return unmanaged_; }
 
-struct R2DCell {
-    uint32_t generation;
-    int32_t cover;
-    int32_t area;
-};
+    template <typename T = uint8_t>
+    T* row(uint32_t y) const noexcept {
+        return (T*)((uint8_t*)data_ + y * stride_);
+    }
 
-struct R2DSpan {
-    uint32_t x0;
-    uint32_t x1;
+    // Row of the UV plane of an NV12 image, each row covers two luma rows
+    uint8_t* chroma_row(uint32_t y) const noexcept {
+        return (uint8_t*)chroma_data_ + y * chroma_stride_;
+    }
+    operator bool() const noexcept { return data_ != nullptr; }
 };
 
-struct R2DRaster {
-    R2DCell* cells_{};
-    R2DSpan* spans_{};
-    uint32_t width_{};
-    uint32_t height_{};
-    uint32_t stride_{};
+// Magnify `src` by an integer `scale` factor into `dst` at (dst_x, dst_y) using nearest-neighbour
+// sampling. Pixels are converted to the destination format if the formats are different.
+static void r2d_blit_scaled_nearest(R2DImage& dst, const R2DImage& src, uint32_t scale,
+                                    uint32_t dst_x = 0, uint32_t dst_y = 0) {
+    assert(scale != 0);
+    assert(r2d_format_bytes_per_pixel(dst.format_) == 4);
+    assert(r2d_format_bytes_per_pixel(src.format_) == 4);
+    if (dst_x >= dst.width_ || dst_y >= dst.height_)
+        return;
+    uint32_t width = r2d_min((uint64_t)src.width_ * scale, (uint64_t)(dst.width_ - dst_x));
+    uint32_t height = r2d_min((uint64_t)src.height_ * scale, (uint64_t)(dst.height_ - dst_y));
+    R2DColor8* dst_data = dst.row<R2DColor8>(dst_y) + dst_x;
+    r2d_scale_image_nearest(dst_data, (uint32_t)(dst.stride_ / 4), width, height,
+                            (const R2DColor8*)src.data_, (uint32_t)(src.stride_ / 4), scale,
+                            r2d_color_bitshift(src.format_),
+                            r2d_color_bitshift(dst.format_));
+}
 
-    int32_t min_x_{};
-    int32_t min_y_{};
-    int32_t max_x_{};
-    int32_t max_y_{};
+// Convert the pixels of a straight alpha image into premultiplied alpha, e.g. before using it as
+// a premultiplied render target
+static void r2d_premultiply_image(R2DImage& image) noexcept {
+    if (r2d_format_bytes_per_pixel(image.format_) != 4 || !r2d_format_has_alpha(image.format_))
+        return;
+    uint32_t alpha_shift = r2d_color_bitshift(image.format_).a;
+    for (uint32_t y = 0; y < image.height_; y++)
+        r2d_convert_alpha_row<true>(image.row<R2DColor8>(y), image.width_, alpha_shift);
+}
 
-    // The generation counter optimizes how often the R2DRaster will be discarded.
-    // R2DRaster will be discarded/cleared only if the generation counter overflowed.
-    // This prevents unnecessary memory writes and saves memory bandwidth.
-    uint32_t prev_gen_{};
-    uint32_t current_gen_{};
+// Convert the pixels of a premultiplied image back into straight alpha, e.g. before presenting
+// a premultiplied render target
+static void r2d_unpremultiply_image(R2DImage& image) noexcept {
+    if (r2d_format_bytes_per_pixel(image.format_) != 4 || !r2d_format_has_alpha(image.format_))
+        return;
+    uint32_t alpha_shift = r2d_color_bitshift(image.format_).a;
+    for (uint32_t y = 0; y < image.height_; y++)
+        r2d_convert_alpha_row<false>(image.row<R2DColor8>(y), image.width_, alpha_shift);
+}
 
-    R2DRaster() {}
+// Convert a row of premultiplied float pixels into 8-bit pixels. `Control` moves the channels
+// into the destination order. The alpha is replaced with 1 for opaque destinations, which keeps
+// the premultiplied color, i.e. the image composited over black.
+template <int Control, bool Unpremultiply, bool Opaque>
+static void r2d_resolve_row_ps(R2DColor8* dst, const float* src, size_t count) noexcept {
+    __m128 zero = _mm_setzero_ps();
+    __m128 one = _mm_set1_ps(1.0f);
+    __m128 scale = _mm_set1_ps(255.0f);
+
+    auto convert = [&](size_t i) {
+        __m128 color = _mm_loadu_ps(src + i * 4);
+        if constexpr (Opaque)
+            color = r2d_set_alpha_ps(color, one);
+        else if constexpr (Unpremultiply)
+            color = r2d_unpremultiply_ps(color);
+        color = _mm_shuffle_ps(color, color, Control);
+        color = _mm_min_ps(_mm_max_ps(color, zero), one);
+        return _mm_cvtps_epi32(_mm_mul_ps(color, scale));
+    };
 
-    R2DRaster(R2DRaster&& other) noexcept :
-        cells_(std::exchange(other.cells_, nullptr)),
-        spans_(std::exchange(other.spans_, nullptr)),
-        width_(std::exchange(other.width_, 0)),
-        height_(std::exchange(other.height_, 0)),
-        stride_(std::exchange(other.stride_, 0)),
-        prev_gen_(std::exchange(other.prev_gen_, 0)),
-        current_gen_(std::exchange(other.current_gen_, 0)) {}
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i c01 = _mm_packs_epi32(convert(i), convert(i + 1));
+        __m128i c23 = _mm_packs_epi32(convert(i + 2), convert(i + 3));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(c01, c23));
+    }
+    for (; i < count; i++) {
+        __m128i c = convert(i);
+        c = _mm_packs_epi32(c, c);
+        dst[i] = (R2DColor8)_mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+    }
+}
+
+// Resolve a float image into a 32-bit image of the same size for presentation. The result is
+// straight alpha unless `premultiplied` is set.
+static void r2d_resolve_image(R2DImage& dst, const R2DImage& src, bool premultiplied = false) {
+    assert(src.format_ == R2DPixelFormat::RGBA32F);
+    assert(dst.width_ == src.width_ && dst.height_ == src.height_);
+    void (*resolve_row)(R2DColor8*, const float*, size_t) noexcept;
+
+#define R2D_RESOLVE_CASE(format, opaque)                                                           \
+    case format:                                                                                   \
+        resolve_row = premultiplied                                                                \
+                          ? &r2d_resolve_row_ps<r2d_format_swizzle_control(format), false, opaque> \
+                          : &r2d_resolve_row_ps<r2d_format_swizzle_control(format), true, opaque>; \
+        break
+
+    switch (dst.format_) {
+        R2D_RESOLVE_CASE(R2DPixelFormat::RGBA8, false);
+        R2D_RESOLVE_CASE(R2DPixelFormat::ARGB8, false);
+        R2D_RESOLVE_CASE(R2DPixelFormat::BGRA8, false);
+        R2D_RESOLVE_CASE(R2DPixelFormat::RGBX8, true);
+        R2D_RESOLVE_CASE(R2DPixelFormat::BGRX8, true);
+        default:
+            R2D_UNREACHABLE();
+    }
+
+#undef R2D_RESOLVE_CASE
+
+    for (uint32_t y = 0; y < src.height_; y++)
+        resolve_row(dst.row<R2DColor8>(y), src.row<const float>(y), src.width_);
+}
+
+// Convert a row of pixels of any format but NV12 into straight or premultiplied RGBA8
+static void r2d_load_rgba_row(R2DColor8* dst, const void* src, R2DPixelFormat format,
+                              const R2DColorBitShift& bitshift, size_t count) noexcept {
+    switch (format) {
+        case R2DPixelFormat::A8: {
+            const uint8_t* alpha = (const uint8_t*)src;
+            __m128i zero = _mm_setzero_si128();
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                __m128i a = _mm_loadu_si128((const __m128i*)(alpha + i));
+                __m128i lo = _mm_unpacklo_epi8(zero, a);
+                __m128i hi = _mm_unpackhi_epi8(zero, a);
+                _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(zero, lo));
+                _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(zero, lo));
+                _mm_storeu_si128((__m128i*)(dst + i + 8), _mm_unpacklo_epi16(zero, hi));
+                _mm_storeu_si128((__m128i*)(dst + i + 12), _mm_unpackhi_epi16(zero, hi));
+            }
+            for (; i < count; i++)
+                dst[i] = (R2DColor8)alpha[i] << 24;
+            break;
+        }
+        case R2DPixelFormat::RGB565:
+            r2d_unpack_rgb565_row(dst, (const uint16_t*)src, count);
+            break;
+        case R2DPixelFormat::RGBA32F:
+            r2d_resolve_row_ps<r2d_format_swizzle_control(R2DPixelFormat::RGBA8), false, false>(
+                dst, (const float*)src, count);
+            break;
+        case R2DPixelFormat::NV12:
+            R2D_UNREACHABLE();
+            break;
+        default: {
+            // The unused byte of opaque formats is at the alpha position
+            R2DColor8 alpha_fill = r2d_format_has_alpha(format) ? 0 : 0xFF000000;
+            r2d_swizzle_row(dst, (const R2DColor8*)src, count, bitshift,
+                            r2d_color_bitshift(R2DPixelFormat::RGBA8), alpha_fill);
+            break;
+        }
+    }
+}
+
+// Convert a row of RGBA8 pixels into any format but NV12. Opaque formats drop the alpha.
+static void r2d_store_rgba_row(void* dst, R2DPixelFormat format, const R2DColorBitShift& bitshift,
+                               const R2DColor8* src, size_t count) noexcept {
+    switch (format) {
+        case R2DPixelFormat::A8: {
+            uint8_t* alpha = (uint8_t*)dst;
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16) {
+                const __m128i* colors = (const __m128i*)(src + i);
+                __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(colors), 24);
+                __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(colors + 1), 24);
+                __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(colors + 2), 24);
+                __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(colors + 3), 24);
+                __m128i a = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3));
+                _mm_storeu_si128((__m128i*)(alpha + i), a);
+            }
+            for (; i < count; i++)
+                alpha[i] = (uint8_t)(src[i] >> 24);
+            break;
+        }
+        case R2DPixelFormat::RGB565:
+            r2d_pack_rgb565_row<false>((uint16_t*)dst, src, nullptr, count, nullptr);
+            break;
+        case R2DPixelFormat::RGBA32F: {
+            float* pixels = (float*)dst;
+            for (size_t i = 0; i < count; i++)
+                _mm_storeu_ps(pixels + i * 4, r2d_color_to_ps(src[i]));
+            break;
+        }
+        case R2DPixelFormat::NV12:
+            R2D_UNREACHABLE();
+            break;
+        default: {
+            R2DColor8 alpha_fill = r2d_format_has_alpha(format) ? 0 : 0xFFu << bitshift.a;
+            r2d_swizzle_row((R2DColor8*)dst, src, count,
+                            r2d_color_bitshift(R2DPixelFormat::RGBA8), bitshift, alpha_fill);
+            break;
+        }
+    }
+}
+
+// Row streaming pixel format converter for every pair of formats but NV12. The channel layouts
+// of 32-bit formats may be replaced to convert from or into layouts that have no pixel format
+// of their own, e.g. window surfaces.
+struct R2DFormatConverter {
+    R2DPixelFormat dst_format{};
+    R2DPixelFormat src_format{};
+    R2DColorBitShift dst_bitshift{};
+    R2DColorBitShift src_bitshift{};
+    R2DAlphaConversion alpha{};
+
+    R2DFormatConverter(R2DPixelFormat dst_format, R2DPixelFormat src_format,
+                       R2DAlphaConversion alpha = R2DAlphaConversion::None) noexcept :
+        dst_format(dst_format), src_format(src_format), alpha(alpha) {
+        assert(dst_format != R2DPixelFormat::NV12 && src_format != R2DPixelFormat::NV12);
+        if (r2d_format_bytes_per_pixel(dst_format) == 4)
+            dst_bitshift = r2d_color_bitshift(dst_format);
+        if (r2d_format_bytes_per_pixel(src_format) == 4)
+            src_bitshift = r2d_color_bitshift(src_format);
+    }
+
+    void convert_row(void* dst, const void* src, size_t count) const noexcept {
+        uint32_t dst_bpp = r2d_format_bytes_per_pixel(dst_format);
+        uint32_t src_bpp = r2d_format_bytes_per_pixel(src_format);
+        if (alpha == R2DAlphaConversion::None) {
+            if (dst_bpp == 4 && src_bpp == 4) {
+                // Go directly from one layout into the other
+                R2DColor8 alpha_fill = 0;
+                if (!r2d_format_has_alpha(src_format) || !r2d_format_has_alpha(dst_format))
+                    alpha_fill = 0xFFu << dst_bitshift.a;
+                r2d_swizzle_row((R2DColor8*)dst, (const R2DColor8*)src, count, src_bitshift,
+                                dst_bitshift, alpha_fill);
+                return;
+            }
+            if (dst_format == src_format) {
+                std::memcpy(dst, src, count * dst_bpp);
+                return;
+            }
+        }
+
+        // Convert through RGBA8 in chunks that stay in the L1 cache
+        constexpr size_t chunk_size = 256;
+        R2DColor8 rgba[chunk_size];
+        uint8_t* dst_bytes = (uint8_t*)dst;
+        const uint8_t* src_bytes = (const uint8_t*)src;
+        for (size_t i = 0; i < count; i += chunk_size) {
+            size_t n = r2d_min(chunk_size, count - i);
+            r2d_load_rgba_row(rgba, src_bytes + i * src_bpp, src_format, src_bitshift, n);
+            if (alpha == R2DAlphaConversion::Premultiply)
+                r2d_convert_alpha_row<true>(rgba, n, 24);
+            else if (alpha == R2DAlphaConversion::Unpremultiply)
+                r2d_convert_alpha_row<false>(rgba, n, 24);
+            r2d_store_rgba_row(dst_bytes + i * dst_bpp, dst_format, dst_bitshift, rgba, n);
+        }
+    }
+};
+
+// Convert a rectangle of pixels between two buffers of any format but NV12. The strides are in
+// bytes.
+static void r2d_convert_pixels(void* dst, size_t dst_stride, R2DPixelFormat dst_format,
+                               const void* src, size_t src_stride, R2DPixelFormat src_format,
+                               uint32_t width, uint32_t height,
+                               R2DAlphaConversion alpha = R2DAlphaConversion::None) noexcept {
+    R2DFormatConverter converter(dst_format, src_format, alpha);
+    for (uint32_t y = 0; y < height; y++)
+        converter.convert_row((uint8_t*)dst + y * dst_stride,
+                              (const uint8_t*)src + y * src_stride, width);
+}
+
+// Convert `width` x `height` pixels of `src` at (src_x, src_y) into `dst` at (dst_x, dst_y). The
+// rectangle is clipped to both images. NV12 images are converted through RGBA8, chroma samples
+// of an NV12 destination are the average of their pixels inside the rectangle.
+static void r2d_convert_image(R2DImage& dst, uint32_t dst_x, uint32_t dst_y, const R2DImage& src,
+                              uint32_t src_x, uint32_t src_y, uint32_t width, uint32_t height,
+                              R2DAlphaConversion alpha = R2DAlphaConversion::None) {
+    if (dst_x >= dst.width_ || dst_y >= dst.height_ || src_x >= src.width_ ||
+        src_y >= src.height_)
+        return;
+    width = r2d_min(width, r2d_min(dst.width_ - dst_x, src.width_ - src_x));
+    height = r2d_min(height, r2d_min(dst.height_ - dst_y, src.height_ - src_y));
+
+    bool dst_nv12 = dst.format_ == R2DPixelFormat::NV12;
+    bool src_nv12 = src.format_ == R2DPixelFormat::NV12;
+    uint32_t dst_bpp = r2d_format_bytes_per_pixel(dst.format_);
+    uint32_t src_bpp = r2d_format_bytes_per_pixel(src.format_);
+    if (!dst_nv12 && !src_nv12) {
+        r2d_convert_pixels(dst.row(dst_y) + (size_t)dst_x * dst_bpp, dst.stride_, dst.format_,
+                           src.row(src_y) + (size_t)src_x * src_bpp, src.stride_, src.format_,
+                           width, height, alpha);
+        return;
+    }
+
+    R2DVector<R2DColor8> rows;
+    rows.resize((size_t)width * 2);
+    R2DColor8* row_colors[2] = {rows.data(), rows.data() + width};
+    R2DFormatConverter to_rgba(R2DPixelFormat::RGBA8,
+                               src_nv12 ? R2DPixelFormat::RGBA8 : src.format_, alpha);
+    R2DFormatConverter from_rgba(dst_nv12 ? R2DPixelFormat::RGBA8 : dst.format_,
+                                 R2DPixelFormat::RGBA8);
+
+    // Load a source row into RGBA8, NV12 chroma samples are shared by their 2x2 pixels
+    auto load_row = [&](R2DColor8* colors, uint32_t y) {
+        if (!src_nv12) {
+            to_rgba.convert_row(colors, src.row(y) + (size_t)src_x * src_bpp, width);
+            return;
+        }
+        const uint8_t* luma = src.row(y);
+        const uint8_t* chroma = src.chroma_row(y >> 1);
+        for (uint32_t i = 0; i < width; i++) {
+            uint32_t x = src_x + i;
+            colors[i] = r2d_yuv_to_rgb(luma[x], chroma[x & ~1u], chroma[(x & ~1u) + 1]);
+        }
+        if (alpha != R2DAlphaConversion::None)
+            to_rgba.convert_row(colors, colors, width);
+    };
+
+    if (!dst_nv12) {
+        for (uint32_t i = 0; i < height; i++) {
+            load_row(row_colors[0], src_y + i);
+            from_rgba.convert_row(dst.row(dst_y + i) + (size_t)dst_x * dst_bpp, row_colors[0],
+                                  width);
+        }
+        return;
+    }
+
+    // An NV12 destination is written in row pairs of its 2x2 chroma blocks
+    for (uint32_t i = 0; i < height;) {
+        uint32_t y = dst_y + i;
+        uint32_t row_count = (y & 1) == 0 && i + 1 < height ? 2 : 1;
+        for (uint32_t k = 0; k < row_count; k++) {
+            R2DColor8* colors = row_colors[k];
+            load_row(colors, src_y + i + k);
+            uint8_t* luma = dst.row(y + k) + dst_x;
+            for (uint32_t j = 0; j < width; j++) {
+                // Opaque colors, the alpha is dropped like for other opaque formats
+                colors[j] = r2d_rgb_to_yuv(colors[j]);
+                luma[j] = (uint8_t)colors[j];
+            }
+        }
+
+        uint8_t* chroma = dst.chroma_row(y >> 1);
+        for (uint32_t x = dst_x & ~1u; x < dst_x + width; x += 2) {
+            uint32_t u = 0;
+            uint32_t v = 0;
+            uint32_t n = 0;
+            for (uint32_t px = r2d_max(x, dst_x); px < r2d_min(x + 2, dst_x + width); px++) {
+                for (uint32_t k = 0; k < row_count; k++) {
+                    R2DColor8 yuv = row_colors[k][px - dst_x];
+                    u += (yuv >> 8) & 0xFF;
+                    v += (yuv >> 16) & 0xFF;
+                    n++;
+                }
+            }
+            chroma[x] = (uint8_t)((u + n / 2) / n);
+            chroma[x + 1] = (uint8_t)((v + n / 2) / n);
+        }
+        i += row_count;
+    }
+}
+
+static void r2d_convert_image(R2DImage& dst, const R2DImage& src,
+                              R2DAlphaConversion alpha = R2DAlphaConversion::None) {
+    r2d_convert_image(dst, 0, 0, src, 0, 0, src.width_, src.height_, alpha);
+}
+
+// Composite rows of premultiplied RGBA8 colors over each other in place of `dst`
+static void r2d_blend_src_over_row(R2DColor8* dst, const R2DColor8* src, size_t count) noexcept {
+    R2DBlendPremulSrcOver blend_fn{};
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i lo = blend_fn(_mm_unpacklo_epi8(s, zero), _mm_unpacklo_epi8(d, zero));
+        __m128i hi = blend_fn(_mm_unpackhi_epi8(s, zero), _mm_unpackhi_epi8(d, zero));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < count; i++)
+        dst[i] = blend_fn(src[i], dst[i]);
+}
+
+// Copy `width` x `height` pixels of `src` at (src_x, src_y) into `dst` at (dst_x, dst_y). The
+// rectangle is clipped to both images and the pixels are converted into the destination format.
+// `dst` and `src` can be the same image, e.g. to scroll it, NV12 images moved by odd offsets are
+// resampled through a temporary copy then. With R2DBlendMode::SrcOver the pixels are composited
+// over the destination, `premultiplied` tells if the 8-bit images hold premultiplied colors.
+// Only SrcCopy and SrcOver are supported.
+static void r2d_blit_image(R2DImage& dst, int32_t dst_x, int32_t dst_y, const R2DImage& src,
+                           int32_t src_x, int32_t src_y, uint32_t width, uint32_t height,
+                           R2DBlendMode blend_mode = R2DBlendMode::SrcCopy,
+                           bool premultiplied = false) {
+    assert(blend_mode == R2DBlendMode::SrcCopy || blend_mode == R2DBlendMode::SrcOver);
+    int32_t skip_x = r2d_max(r2d_max(-dst_x, -src_x), 0);
+    int32_t skip_y = r2d_max(r2d_max(-dst_y, -src_y), 0);
+    dst_x += skip_x;
+    src_x += skip_x;
+    dst_y += skip_y;
+    src_y += skip_y;
+    int64_t w = r2d_min((int64_t)width - skip_x,
+                        r2d_min((int64_t)dst.width_ - dst_x, (int64_t)src.width_ - src_x));
+    int64_t h = r2d_min((int64_t)height - skip_y,
+                        r2d_min((int64_t)dst.height_ - dst_y, (int64_t)src.height_ - src_y));
+    if (w <= 0 || h <= 0)
+        return;
+
+    bool nv12 = dst.format_ == R2DPixelFormat::NV12 || src.format_ == R2DPixelFormat::NV12;
+    uint32_t dst_bpp = r2d_format_bytes_per_pixel(dst.format_);
+    uint32_t src_bpp = r2d_format_bytes_per_pixel(src.format_);
+    uint8_t* dst_data = dst.row(dst_y) + (size_t)dst_x * dst_bpp;
+    const uint8_t* src_data = src.row(src_y) + (size_t)src_x * src_bpp;
+
+    if (blend_mode == R2DBlendMode::SrcCopy) {
+        if (dst.format_ != src.format_ ||
+            (nv12 && ((dst_x | dst_y | src_x | src_y) & 1) != 0)) {
+            // The conversion reads and writes in one pass, e.g. NV12 moved by odd offsets, so an
+            // overlapping source is copied first. NV12 copies start on a 2x2 chroma block.
+            uint32_t last_y = (uint32_t)h - 1;
+            const uint8_t* src_end = src.row(src_y + last_y) + (src_x + w) * src_bpp;
+            const uint8_t* dst_end = dst.row(dst_y + last_y) + (dst_x + w) * dst_bpp;
+            bool overlap = dst_data < src_end && src_data < dst_end;
+            if (dst.format_ == R2DPixelFormat::NV12 && src.format_ == R2DPixelFormat::NV12) {
+                // Rows next to each other can share a chroma row
+                const uint8_t* src_chroma = src.chroma_row(src_y >> 1) + (src_x & ~1);
+                const uint8_t* dst_chroma = dst.chroma_row(dst_y >> 1) + (dst_x & ~1);
+                const uint8_t* src_chroma_end =
+                    src.chroma_row((src_y + last_y) >> 1) + ((src_x + w - 1) | 1) + 1;
+                const uint8_t* dst_chroma_end =
+                    dst.chroma_row((dst_y + last_y) >> 1) + ((dst_x + w - 1) | 1) + 1;
+                overlap |= dst_chroma < src_chroma_end && src_chroma < dst_chroma_end;
+            }
+            if (overlap) {
+                uint32_t block = src.format_ == R2DPixelFormat::NV12 ? ~1u : ~0u;
+                uint32_t copy_x = src_x & block;
+                uint32_t copy_y = src_y & block;
+                R2DImage copy = src.view(copy_x, copy_y, (uint32_t)w + src_x - copy_x,
+                                         (uint32_t)h + src_y - copy_y)
+                                    .clone();
+                r2d_convert_image(dst, dst_x, dst_y, copy, src_x - copy_x, src_y - copy_y,
+                                  (uint32_t)w, (uint32_t)h);
+                return;
+            }
+            r2d_convert_image(dst, dst_x, dst_y, src, src_x, src_y, (uint32_t)w, (uint32_t)h);
+            return;
+        }
+        r2d_copy_rows(dst_data, dst.stride_, src_data, src.stride_, (size_t)w * dst_bpp,
+                      (uint32_t)h);
+        if (nv12) {
+            // Both images have the same format and the offsets are on 2x2 chroma blocks
+            r2d_copy_rows(dst.chroma_row(dst_y >> 1) + dst_x, dst.chroma_stride_,
+                          src.chroma_row(src_y >> 1) + src_x, src.chroma_stride_,
+                          (size_t)r2d_chroma_size((uint32_t)w) * 2, r2d_chroma_size((uint32_t)h));
+        }
+        return;
+    }
+
+    // Composite in premultiplied RGBA8, float images are always premultiplied
+    assert(!nv12);
+    bool src_premultiplied = premultiplied || src.format_ == R2DPixelFormat::RGBA32F;
+    bool dst_premultiplied = premultiplied || dst.format_ == R2DPixelFormat::RGBA32F;
+    R2DFormatConverter load_src(R2DPixelFormat::RGBA8, src.format_,
+                                src_premultiplied ? R2DAlphaConversion::None
+                                                  : R2DAlphaConversion::Premultiply);
+    R2DFormatConverter load_dst(R2DPixelFormat::RGBA8, dst.format_,
+                                dst_premultiplied ? R2DAlphaConversion::None
+                                                  : R2DAlphaConversion::Premultiply);
+    R2DFormatConverter store_dst(dst.format_, R2DPixelFormat::RGBA8,
+                                 dst_premultiplied ? R2DAlphaConversion::None
+                                                   : R2DAlphaConversion::Unpremultiply);
+    R2DVector<R2DColor8> rows;
+    rows.resize((size_t)w * 2);
+    R2DColor8* src_row = rows.data();
+    R2DColor8* dst_row = rows.data() + w;
+
+    // The whole source row is loaded first, which also handles overlapping rows. Views of the
+    // same image overlap too, so the order only depends on the addresses.
+    bool bottom_up = dst_data > src_data;
+    for (int64_t i = 0; i < h; i++) {
+        int64_t y = bottom_up ? h - 1 - i : i;
+        uint8_t* dst_pixels = dst_data + y * dst.stride_;
+        load_src.convert_row(src_row, src_data + y * src.stride_, w);
+        load_dst.convert_row(dst_row, dst_pixels, w);
+        r2d_blend_src_over_row(dst_row, src_row, w);
+        store_dst.convert_row(dst_pixels, dst_row, w);
+    }
+}
+
+// Move the contents of an image by (dx, dy) pixels. The exposed area keeps its old pixels and
+// is meant to be redrawn, e.g. with the clip rect set to it.
+static void r2d_scroll_image(R2DImage& image, int32_t dx, int32_t dy) {
+    r2d_blit_image(image, dx, dy, image, 0, 0, image.width_, image.height_);
+}
+
+// Map integral image coordinates into [0, size - 1] according to the extend mode
+template <R2DExtendMode ExtendMode>
+R2D_FORCEINLINE static __m128 r2d_extend_coord4(__m128 i, __m128 size, __m128 inv_size) noexcept {
+    __m128 zero = _mm_setzero_ps();
+    __m128 last = _mm_sub_ps(size, _mm_set1_ps(1.0f));
+    if constexpr (ExtendMode == R2DExtendMode::Pad) {
+        return _mm_min_ps(_mm_max_ps(i, zero), last);
+    }
+
+    __m128 period = size;
+    if constexpr (ExtendMode == R2DExtendMode::Reflect) {
+        period = _mm_add_ps(size, size);
+        inv_size = _mm_mul_ps(inv_size, _mm_set1_ps(0.5f));
+    }
+
+    // i mod period, the division may be off by one period
+    __m128 r = _mm_sub_ps(i, _mm_mul_ps(period, r2d_floor_ps(_mm_mul_ps(i, inv_size))));
+    r = _mm_sub_ps(r, _mm_and_ps(_mm_cmpge_ps(r, period), period));
+    r = _mm_add_ps(r, _mm_and_ps(_mm_cmplt_ps(r, zero), period));
+
+    if constexpr (ExtendMode == R2DExtendMode::Reflect) {
+        __m128 mirror = _mm_sub_ps(_mm_sub_ps(period, _mm_set1_ps(1.0f)), r);
+        r = r2d_select_ps(_mm_cmpge_ps(r, size), mirror, r);
+    }
+
+    return _mm_min_ps(_mm_max_ps(r, zero), last);
+}
+
+// Map a single integral image coordinate into [0, size - 1] according to the extend mode
+R2D_FORCEINLINE
+static int32_t r2d_extend_coord(int32_t i, int32_t size, R2DExtendMode extend_mode) noexcept {
+    switch (extend_mode) {
+        case R2DExtendMode::Pad:
+            return r2d_clamp(i, 0, size - 1);
+        case R2DExtendMode::Repeat:
+            i %= size;
+            return i < 0 ? i + size : i;
+        case R2DExtendMode::Reflect: {
+            int32_t period = size * 2;
+            i %= period;
+            if (i < 0)
+                i += period;
+            return i >= size ? period - 1 - i : i;
+        }
+    }
+    return 0;
+}
+
+// Fetches image pattern colors. Pixel centers are mapped into the image space; the nearest filter
+// takes the texel containing the sample, the bilinear filter blends the four closest texels in
+// premultiplied space. An integer translation copies the image rows directly. A8 texels are read
+// as black with the mask as alpha, like r2d_load_rgba_row() does.
+struct R2DFetchPattern {
+    const R2DColor8* data;
+    const uint8_t* mask; // Texels of A8 images, null for 32-bit images
+    int32_t width;
+    int32_t height;
+    size_t stride; // In pixels
+    R2DColorBitShift bitpos;
+    R2DColor8 alpha_fill; // Alpha of images without an alpha channel
+    bool swizzle;
+    float m[6];  // Device space to image space
+    R2DExtendMode extend_mode;
+    R2DPatternFilter filter;
+    bool integer_translate;
+    int32_t tx;
+    int32_t ty;
+
+    R2DFetchPattern(const R2DSourcePattern& pattern, const R2DAffine& inv_transform) noexcept {
+        const R2DImage* image = pattern.image;
+        bool a8 = image->format_ == R2DPixelFormat::A8;
+        assert((a8 || r2d_format_bytes_per_pixel(image->format_) == 4) &&
+               "Only 32-bit and A8 images can be used as pattern");
+        data = (const R2DColor8*)image->data_;
+        mask = a8 ? (const uint8_t*)image->data_ : nullptr;
+        width = (int32_t)image->width_;
+        height = (int32_t)image->height_;
+        stride = image->stride_ / r2d_format_bytes_per_pixel(image->format_);
+        bitpos = r2d_color_bitshift(a8 ? R2DPixelFormat::RGBA8 : image->format_);
+        alpha_fill = r2d_format_has_alpha(image->format_) ? 0 : 0xFF000000;
+        swizzle = image->format_ != R2DPixelFormat::RGBA8 && !a8;
+        extend_mode = pattern.extend_mode;
+        filter = pattern.filter;
+
+        R2DAffine device_to_image = inv_transform;
+        if (pattern.transform) {
+            R2DAffine inv_pattern;
+            if (!pattern.transform->invert(inv_pattern))
+                inv_pattern = R2DAffine(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+            device_to_image = inv_pattern * inv_transform;
+        }
+
+        std::memcpy(m, device_to_image.m, sizeof(m));
+        integer_translate = device_to_image.type <= R2DTransformType::Translate &&
+                            m[2] == std::floor(m[2]) && m[5] == std::floor(m[5]) &&
+                            std::fabs(m[2]) < 1e9f && std::fabs(m[5]) < 1e9f;
+        tx = integer_translate ? (int32_t)m[2] : 0;
+        ty = integer_translate ? (int32_t)m[5] : 0;
+    }
+
+    void fetch(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        if (integer_translate) {
+            fetch_translate(dst, x, y, count);
+        } else if (filter == R2DPatternFilter::Nearest) {
+            switch (extend_mode) {
+                case R2DExtendMode::Pad:
+                    fetch_nearest<R2DExtendMode::Pad>(dst, x, y, count);
+                    break;
+                case R2DExtendMode::Repeat:
+                    fetch_nearest<R2DExtendMode::Repeat>(dst, x, y, count);
+                    break;
+                case R2DExtendMode::Reflect:
+                    fetch_nearest<R2DExtendMode::Reflect>(dst, x, y, count);
+                    break;
+            }
+        } else {
+            switch (extend_mode) {
+                case R2DExtendMode::Pad:
+                    fetch_bilinear<R2DExtendMode::Pad>(dst, x, y, count);
+                    break;
+                case R2DExtendMode::Repeat:
+                    fetch_bilinear<R2DExtendMode::Repeat>(dst, x, y, count);
+                    break;
+                case R2DExtendMode::Reflect:
+                    fetch_bilinear<R2DExtendMode::Reflect>(dst, x, y, count);
+                    break;
+            }
+            return;
+        }
+
+        if (swizzle) {
+            R2DColorBitShift rgba_bitpos = r2d_color_bitshift(R2DPixelFormat::RGBA8);
+            for (uint32_t i = 0; i < count; i++) {
+                dst[i] = r2d_swizzle_color(dst[i], bitpos, rgba_bitpos) | alpha_fill;
+            }
+        }
+    }
+
+    // Every device pixel maps onto exactly one texel, whole runs of the image row are copied
+    void fetch_translate(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        size_t row_y = (size_t)r2d_extend_coord(y + ty, height, extend_mode);
+        const R2DColor8* row = data + row_y * stride;
+        const uint8_t* mask_row = mask ? mask + row_y * stride : nullptr;
+        int32_t sx = x + tx;
+        uint32_t i = 0;
+
+        while (i < count) {
+            int32_t ex = r2d_extend_coord(sx, width, extend_mode);
+            bool forward = true;
+            if (extend_mode == R2DExtendMode::Pad) {
+                forward = sx >= 0 && sx < width;
+            } else if (extend_mode == R2DExtendMode::Reflect) {
+                int32_t period = width * 2;
+                int32_t m = sx % period;
+                forward = (m < 0 ? m + period : m) < width;
+            }
+
+            if (forward) {
+                uint32_t run = r2d_min((uint32_t)(width - ex), count - i);
+                if (mask_row)
+                    r2d_load_rgba_row(dst + i, mask_row + ex, R2DPixelFormat::A8, bitpos, run);
+                else
+                    std::memcpy(dst + i, row + ex, run * sizeof(R2DColor8));
+                i += run;
+                sx += run;
+            } else if (extend_mode == R2DExtendMode::Pad) {
+                // Repeat the edge texel up to the image or to the end of the span
+                uint32_t run = count - i;
+                if (sx < 0)
+                    run = r2d_min(run, (uint32_t)-sx);
+                R2DColor8 color = texel(ex, (int32_t)row_y);
+                for (uint32_t j = 0; j < run; j++) {
+                    dst[i + j] = color;
+                }
+                i += run;
+                sx += run;
+            } else {
+                // Mirrored period of a reflected pattern
+                uint32_t run = r2d_min((uint32_t)(ex + 1), count - i);
+                for (uint32_t j = 0; j < run; j++) {
+                    dst[i + j] = texel(ex - (int32_t)j, (int32_t)row_y);
+                }
+                i += run;
+                sx += run;
+            }
+        }
+    }
+
+    template <R2DExtendMode ExtendMode>
+    R2D_FORCEINLINE void fetch_nearest(R2DColor8* dst, int32_t x, int32_t y,
+                                       uint32_t count) const noexcept {
+        float fx = (float)x + 0.5f;
+        float fy = (float)y + 0.5f;
+        __m128 steps = _mm_setr_ps(0, 1, 2, 3);
+        __m128 u = _mm_add_ps(_mm_set1_ps(m[0] * fx + m[1] * fy + m[2]),
+                              _mm_mul_ps(steps, _mm_set1_ps(m[0])));
+        __m128 v = _mm_add_ps(_mm_set1_ps(m[3] * fx + m[4] * fy + m[5]),
+                              _mm_mul_ps(steps, _mm_set1_ps(m[3])));
+        __m128 du = _mm_set1_ps(m[0] * 4.0f);
+        __m128 dv = _mm_set1_ps(m[3] * 4.0f);
+        __m128 size_x = _mm_set1_ps((float)width);
+        __m128 size_y = _mm_set1_ps((float)height);
+        __m128 inv_size_x = _mm_set1_ps(1.0f / (float)width);
+        __m128 inv_size_y = _mm_set1_ps(1.0f / (float)height);
+        __m128 limit = _mm_set1_ps(16777216.0f);
+
+        for (uint32_t i = 0; i < count; i += 4) {
+            __m128 iu = r2d_floor_ps(_mm_min_ps(_mm_max_ps(u, _mm_sub_ps(_mm_setzero_ps(), limit)),
+                                                limit));
+            __m128 iv = r2d_floor_ps(_mm_min_ps(_mm_max_ps(v, _mm_sub_ps(_mm_setzero_ps(), limit)),
+                                                limit));
+            iu = r2d_extend_coord4<ExtendMode>(iu, size_x, inv_size_x);
+            iv = r2d_extend_coord4<ExtendMode>(iv, size_y, inv_size_y);
+
+            alignas(16) int32_t ix[4];
+            alignas(16) int32_t iy[4];
+            _mm_store_si128((__m128i*)ix, _mm_cvttps_epi32(iu));
+            _mm_store_si128((__m128i*)iy, _mm_cvttps_epi32(iv));
+
+            uint32_t n = r2d_min(count - i, 4u);
+            for (uint32_t j = 0; j < n; j++) {
+                dst[i + j] = texel(ix[j], iy[j]);
+            }
+
+            u = _mm_add_ps(u, du);
+            v = _mm_add_ps(v, dv);
+        }
+    }
+
+    // Texel in the image format, A8 texels are converted
+    R2D_FORCEINLINE R2DColor8 texel(int32_t x, int32_t y) const noexcept {
+        if (mask)
+            return (R2DColor8)mask[(size_t)y * stride + x] << 24;
+        return data[(size_t)y * stride + x];
+    }
+
+    R2D_FORCEINLINE R2DColor8 load_texel(int32_t x, int32_t y) const noexcept {
+        R2DColor8 color = texel(x, y);
+        if (swizzle) {
+            R2DColorBitShift rgba_bitpos = r2d_color_bitshift(R2DPixelFormat::RGBA8);
+            color = r2d_swizzle_color(color, bitpos, rgba_bitpos) | alpha_fill;
+        }
+        return color;
+    }
+
+    template <R2DExtendMode ExtendMode>
+    R2D_FORCEINLINE void fetch_bilinear(R2DColor8* dst, int32_t x, int32_t y,
+                                        uint32_t count) const noexcept {
+        // Sample positions are relative to the texel centers
+        float fx = (float)x + 0.5f;
+        float fy = (float)y + 0.5f;
+        __m128 steps = _mm_setr_ps(0, 1, 2, 3);
+        __m128 u = _mm_add_ps(_mm_set1_ps(m[0] * fx + m[1] * fy + m[2] - 0.5f),
+                              _mm_mul_ps(steps, _mm_set1_ps(m[0])));
+        __m128 v = _mm_add_ps(_mm_set1_ps(m[3] * fx + m[4] * fy + m[5] - 0.5f),
+                              _mm_mul_ps(steps, _mm_set1_ps(m[3])));
+        __m128 du = _mm_set1_ps(m[0] * 4.0f);
+        __m128 dv = _mm_set1_ps(m[3] * 4.0f);
+        __m128 one = _mm_set1_ps(1.0f);
+        __m128 size_x = _mm_set1_ps((float)width);
+        __m128 size_y = _mm_set1_ps((float)height);
+        __m128 inv_size_x = _mm_set1_ps(1.0f / (float)width);
+        __m128 inv_size_y = _mm_set1_ps(1.0f / (float)height);
+        __m128 limit = _mm_set1_ps(16777216.0f);
+        __m128i zero = _mm_setzero_si128();
+
+        for (uint32_t i = 0; i < count; i += 4) {
+            __m128 cu = _mm_min_ps(_mm_max_ps(u, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+            __m128 cv = _mm_min_ps(_mm_max_ps(v, _mm_sub_ps(_mm_setzero_ps(), limit)), limit);
+            __m128 u0 = r2d_floor_ps(cu);
+            __m128 v0 = r2d_floor_ps(cv);
+
+            // 8-bit weights of the second texel in each direction
+            alignas(16) int32_t wx[4];
+            alignas(16) int32_t wy[4];
+            _mm_store_si128((__m128i*)wx,
+                            _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(cu, u0), _mm_set1_ps(256.0f))));
+            _mm_store_si128((__m128i*)wy,
+                            _mm_cvttps_epi32(_mm_mul_ps(_mm_sub_ps(cv, v0), _mm_set1_ps(256.0f))));
+
+            alignas(16) int32_t x0[4];
+            alignas(16) int32_t x1[4];
+            alignas(16) int32_t y0[4];
+            alignas(16) int32_t y1[4];
+            _mm_store_si128(
+                (__m128i*)x0,
+                _mm_cvttps_epi32(r2d_extend_coord4<ExtendMode>(u0, size_x, inv_size_x)));
+            _mm_store_si128((__m128i*)x1,
+                            _mm_cvttps_epi32(r2d_extend_coord4<ExtendMode>(_mm_add_ps(u0, one),
+                                                                           size_x, inv_size_x)));
+            _mm_store_si128(
+                (__m128i*)y0,
+                _mm_cvttps_epi32(r2d_extend_coord4<ExtendMode>(v0, size_y, inv_size_y)));
+            _mm_store_si128((__m128i*)y1,
+                            _mm_cvttps_epi32(r2d_extend_coord4<ExtendMode>(_mm_add_ps(v0, one),
+                                                                           size_y, inv_size_y)));
+
+            uint32_t n = r2d_min(count - i, 4u);
+            for (uint32_t j = 0; j < n; j++) {
+                R2DColor8 p00 = load_texel(x0[j], y0[j]);
+                R2DColor8 p10 = load_texel(x1[j], y0[j]);
+                R2DColor8 p01 = load_texel(x0[j], y1[j]);
+                R2DColor8 p11 = load_texel(x1[j], y1[j]);
+                bool opaque = (p00 & p10 & p01 & p11) >> 24 == 0xFF;
+                if (!opaque) {
+                    p00 = r2d_rgb_alphamult(p00, p00 >> 24) | (p00 & 0xFF000000);
+                    p10 = r2d_rgb_alphamult(p10, p10 >> 24) | (p10 & 0xFF000000);
+                    p01 = r2d_rgb_alphamult(p01, p01 >> 24) | (p01 & 0xFF000000);
+                    p11 = r2d_rgb_alphamult(p11, p11 >> 24) | (p11 & 0xFF000000);
+                }
+
+                // Vertical pass on both columns, then the horizontal pass. The weights of each
+                // pass sum up to 256 so the 16-bit lanes cannot overflow.
+                __m128i texels = _mm_setr_epi32(p00, p10, p01, p11);
+                __m128i row0 = _mm_unpacklo_epi8(texels, zero);
+                __m128i row1 = _mm_unpackhi_epi8(texels, zero);
+                __m128i col = _mm_add_epi16(_mm_mullo_epi16(row0, _mm_set1_epi16(256 - wy[j])),
+                                            _mm_mullo_epi16(row1, _mm_set1_epi16(wy[j])));
+                col = _mm_srli_epi16(col, 8);
+                __m128i weight_x = _mm_unpacklo_epi64(_mm_set1_epi16(256 - wx[j]),
+                                                      _mm_set1_epi16(wx[j]));
+                col = _mm_mullo_epi16(col, weight_x);
+                col = _mm_srli_epi16(_mm_add_epi16(col, _mm_srli_si128(col, 8)), 8);
+                R2DColor8 color = _mm_cvtsi128_si32(_mm_packus_epi16(col, col));
+
+                if (!opaque) {
+                    uint32_t alpha = color >> 24;
+                    color = r2d_rgb_alphamult(color, r2d_alpharcp(alpha)) | (alpha << 24);
+                }
+                dst[i + j] = color;
+            }
+
+            u = _mm_add_ps(u, du);
+            v = _mm_add_ps(v, dv);
+        }
+    }
+};
+
+// Fetches colors from a buffer which has been filled for the raster bounds beforehand
+struct R2DFetchBuffer {
+    const R2DColor8* data;
+    size_t stride;
+    int32_t x0;
+    int32_t y0;
+
+    void fetch(R2DColor8* dst, int32_t x, int32_t y, uint32_t count) const noexcept {
+        std::memcpy(dst, data + (size_t)(y - y0) * stride + (x - x0), count * sizeof(R2DColor8));
+    }
+};
+
+struct R2DCell {
+    uint32_t generation;
+    int32_t cover;
+    int32_t area;
+};
+
+struct R2DSpan {
+    uint32_t x0;
+    uint32_t x1;
+};
+
+struct R2DRaster {
+    R2DCell* cells_{};
+    R2DSpan* spans_{};
+    uint32_t width_{};
+    uint32_t height_{};
+    uint32_t stride_{};
+
+    int32_t min_x_{};
+    int32_t min_y_{};
+    int32_t max_x_{};
+    int32_t max_y_{};
+
+    // The generation counter optimizes how often the R2DRaster will be discarded.
+    // R2DRaster will be discarded/cleared only if the generation counter overflowed.
+    // This prevents unnecessary memory writes and saves memory bandwidth.
+    uint32_t prev_gen_{};
+    uint32_t current_gen_{};
+
+    R2DRaster() {}
+
+    R2DRaster(R2DRaster&& other) noexcept :
+        cells_(std::exchange(other.cells_, nullptr)),
+        spans_(std::exchange(other.spans_, nullptr)),
+        width_(std::exchange(other.width_, 0)),
+        height_(std::exchange(other.height_, 0)),
+        stride_(std::exchange(other.stride_, 0)),
+        prev_gen_(std::exchange(other.prev_gen_, 0)),
+        current_gen_(std::exchange(other.current_gen_, 0)) {}
 
     ~R2DRaster() {
         if (cells_)
@@ -639,12 +2328,46 @@ struct R2DPath {
     R2D_FORCEINLINE void uline_to(float x, float y) {}
 };
 
+// Blend function object bound to the pixel format of the render target. The compositing loops
+// are instantiated for each format so the channel swizzles are resolved at compile time.
+template <typename BlendFnT, R2DPixelFormat Format>
+struct R2DTargetBlend : BlendFnT {
+    using blend_type = BlendFnT;
+    static constexpr R2DPixelFormat format = Format;
+
+    // RGB565 targets are unpacked into opaque RGBA rows before blending
+    static constexpr R2DColorBitShift bitpos =
+        r2d_color_bitshift(Format == R2DPixelFormat::RGB565 ? R2DPixelFormat::RGBX8 : Format);
+    static constexpr bool opaque = !r2d_format_has_alpha(Format);
+
+    // pshuflw/pshufhw control that moves 16-bit channels from the target format to RGBA order
+    static constexpr int unswizzle_control =
+        (int)(bitpos.r / 8 | (bitpos.g / 8) << 2 | (bitpos.b / 8) << 4 | (bitpos.a / 8) << 6);
+
+    // pshuflw/pshufhw control that moves 16-bit channels from RGBA order to the target format
+    static constexpr int swizzle_control =
+        (int)(0 << (bitpos.r / 4) | 1 << (bitpos.g / 4) | 2 << (bitpos.b / 4) |
+              3 << (bitpos.a / 4));
+};
+
+// Solid source of linear light blending. Over opaque destination pixels with full coverage each
+// channel of the result only depends on the same channel of the destination, `channels` holds
+// these results already shifted into the render target format.
+struct R2DLinearSolid {
+    __m128i color;  // Straight sRGB color in all four pixels
+    __m128i linear; // Premultiplied linear color of two pixels
+    uint32_t channels[3][256];
+    uint32_t alpha;
+};
+
 struct R2DContext {
     R2DImage* rt_{};
-    R2DColorBitShift rt_bitpos_{};
     R2DRaster* raster_{};
     const R2DSource* source_{};
     R2DBlendMode blend_mode_{};
+    uint32_t flags_{r2d_context_flag(R2DContextFlags::Blending) |
+                    r2d_context_flag(R2DContextFlags::AntiAliasing)};
+    uint32_t thread_count_{1};
     R2DLineJoin line_join_{};
     float miter_limit_{};
     R2DRect clip_rect_{};
@@ -663,15 +2386,42 @@ struct R2DContext {
     uint32_t clip_stack_pos{};
 
     R2DVector<R2DPoint> tmp_line_normals_;
+    R2DVector<R2DPoint> tmp_dash_points_;
+    R2DVector<R2DPoint> tmp_first_dash_points_;
+    R2DVector<R2DPoint> tmp_stroke_points_;
+    R2DVector<R2DPoint> tmp_transformed_points_;
+    R2DVector<R2DPoint> tmp_shape_points_;
+    R2DVector<R2DColor8> tmp_span_colors_;
+    R2DVector<uint8_t> tmp_span_coverage_;
+    R2DVector<R2DColor8> tmp_mesh_colors_;
+    R2DVector<R2DColor8> tmp_target_row_;
+    R2DVector<R2DFixedBox> tmp_rect_boxes_;
+    R2DVector<uint32_t> tmp_rect_band_offsets_;
+    R2DVector<uint32_t> tmp_rect_band_items_;
     R2DPath imm_path_{};
 
+    // Vertices are transformed by `transform_` (post * pre) before being added into the raster.
+    // Line thickness and dash lengths are specified in device space.
+    R2DAffine pre_transform_{};
+    R2DAffine post_transform_{};
+    R2DAffine transform_{};
+    R2DVector<R2DAffine> transform_stack_;
+
+    // Dash pattern. The pattern is always stored with an even number of entries alternating
+    // between "on" and "off" lengths.
+    R2DVector<float> dash_array_;
+    float dash_offset_{};
+    float dash_length_{};
+
     R2DContext() {}
     R2DContext(const R2DContext&) = delete;
     ~R2DContext() {}
 
-    void set_render_target(R2DImage* image) noexcept {
-        rt_ = image;
-        rt_bitpos_ = r2d_color_bitshift(image->format_);
+    void set_render_target(R2DImage* image) noexcept { rt_ = image; }
+
+    // Number of threads that clears of large render targets are split across
+    void set_thread_count(uint32_t thread_count) noexcept {
+        thread_count_ = r2d_max(thread_count, 1u);
     }
 
     void set_raster(R2DRaster* raster) noexcept { raster_ = raster; }
@@ -698,21 +2448,131 @@ struct R2DContext {
 
     void set_line_join(R2DLineJoin line_join) noexcept { line_join_ = line_join; }
 
+    // Set the dash pattern used by lines and polylines. The dash lengths alternate between the
+    // visible and the invisible parts of the stroke. An odd number of dashes is repeated to make
+    // it even. Pass zero count to disable dashing.
+    void set_dash(const float* dashes, size_t count, float offset = 0.0f) {
+        dash_array_.clear();
+        dash_length_ = 0.0f;
+        dash_offset_ = 0.0f;
+        if (!dashes || count == 0)
+            return;
+
+        size_t num_dashes = (count & 1) ? count * 2 : count;
+        dash_array_.reserve(num_dashes);
+        for (size_t i = 0; i < num_dashes; i++) {
+            float dash = dashes[i % count];
+            if (dash < 0.0f) {
+                dash_array_.clear();
+                dash_length_ = 0.0f;
+                return;
+            }
+            dash_array_.push_back(dash);
+            dash_length_ += dash;
+        }
+
+        if (dash_length_ <= 0.0f) {
+            dash_array_.clear();
+            dash_length_ = 0.0f;
+            return;
+        }
+
+        dash_offset_ = std::fmod(offset, dash_length_);
+        if (dash_offset_ < 0.0f)
+            dash_offset_ += dash_length_;
+    }
+
+    bool is_dashed() const noexcept { return dash_length_ > 0.0f; }
+
     void set_fill_mode(R2DFillMode fill_mode) noexcept {}
 
-    void set_pre_transform_matrix(const R2DMatrix& matrix) noexcept {}
+    // Set the transformation applied to the vertices before the post-transform matrix
+    void set_pre_transform_matrix(const R2DMatrix& matrix) noexcept {
+        set_pre_transform(R2DAffine(matrix));
+    }
+
+    // Set the transformation applied to the vertices after the pre-transform matrix
+    void set_post_transform_matrix(const R2DMatrix& matrix) noexcept {
+        set_post_transform(R2DAffine(matrix));
+    }
+
+    void set_pre_transform(const R2DAffine& transform) noexcept {
+        pre_transform_ = transform;
+        update_transform();
+    }
+
+    void set_post_transform(const R2DAffine& transform) noexcept {
+        post_transform_ = transform;
+        update_transform();
+    }
+
+    // Compose `transform` into the pre-transform, `transform` is applied to the vertices first.
+    // This is what a scene graph does when descending into a child node.
+    void apply_transform(const R2DAffine& transform) noexcept {
+        pre_transform_ *= transform;
+        update_transform();
+    }
+
+    // Save the current pre-transform, it will be restored by the matching pop_transform()
+    void push_transform() { transform_stack_.push_back(pre_transform_); }
+
+    void pop_transform() noexcept {
+        assert(!transform_stack_.empty() && "Transform stack underflow");
+        pre_transform_ = transform_stack_.back();
+        transform_stack_.pop_back();
+        update_transform();
+    }
+
+    void update_transform() noexcept { transform_ = post_transform_ * pre_transform_; }
+
+    R2D_FORCEINLINE R2DPoint transform_point(const R2DPoint& p) const noexcept {
+        return transform_.transform(p);
+    }
+
+    // Transform an array of vertices with the current transformation
+    R2D_FORCEINLINE void transform_points(R2DPoint* dst, const R2DPoint* src,
+                                          size_t count) const noexcept {
+        switch (transform_.type) {
+            case R2DTransformType::Identity:
+                std::memcpy(dst, src, count * sizeof(R2DPoint));
+                break;
+            case R2DTransformType::Translate:
+                r2d_translate_points(dst, src, count, transform_.m[2], transform_.m[5]);
+                break;
+            default:
+                r2d_transform_points(dst, src, count, transform_);
+                break;
+        }
+    }
+
+    // Returns the vertices in device space. No copy is made if the transformation is identity,
+    // otherwise the vertices are transformed into a temporary buffer.
+    const R2DPoint* transform_vertices(const R2DPoint* verts, size_t count) {
+        if (transform_.is_identity())
+            return verts;
+        tmp_transformed_points_.resize(count);
+        transform_points(tmp_transformed_points_.data(), verts, count);
+        return tmp_transformed_points_.data();
+    }
 
-    void set_post_transform_matrix(const R2DMatrix& matrix) noexcept {}
+    void enable(R2DContextFlags flag) noexcept { flags_ |= r2d_context_flag(flag); }
 
-    void enable(R2DContextFlags flag) noexcept {}
+    void disable(R2DContextFlags flag) noexcept { flags_ &= ~r2d_context_flag(flag); }
 
-    void disable(R2DContextFlags flag) noexcept {}
+    bool is_enabled(R2DContextFlags flag) const noexcept {
+        return (flags_ & r2d_context_flag(flag)) != 0;
+    }
 
     void add_path(const R2DPath& path) {}
 
     void add_path_filled() {}
 
     inline void add_line(const R2DPoint& v0, const R2DPoint& v1) {
+        add_stroke_line(transform_point(v0), transform_point(v1));
+    }
+
+    // Stroke a single line segment given in device space
+    inline void add_stroke_line(const R2DPoint& v0, const R2DPoint& v1) {
         float dx = -(v1.y - v0.y);
         float dy = v1.x - v0.x;
         float inv_len = line_thickness_ / r2d_sqrt(dy * dy + dx * dx);
@@ -730,11 +2590,30 @@ struct R2DContext {
         if (count < 3)
             return;
         verts += first_vertex;
-        plot_move_to(verts[0].x, verts[0].y);
-        for (size_t i = 1; i < count; i++) {
-            plot_line_to(verts[i].x, verts[i].y);
+
+        if (transform_.is_identity()) {
+            plot_move_to(verts[0].x, verts[0].y);
+            for (size_t i = 1; i < count; i++) {
+                plot_line_to(verts[i].x, verts[i].y);
+            }
+            plot_line_to(verts[0].x, verts[0].y);
+            plot_end();
+            return;
+        }
+
+        // Transform the vertices in small batches to avoid copying the whole array
+        static constexpr size_t batch_size = 64;
+        R2DPoint batch[batch_size];
+        R2DPoint first = transform_point(verts[0]);
+        plot_move_to(first.x, first.y);
+        for (size_t i = 1; i < count; i += batch_size) {
+            size_t num_verts = r2d_min(count - i, batch_size);
+            transform_points(batch, verts + i, num_verts);
+            for (size_t j = 0; j < num_verts; j++) {
+                plot_line_to(batch[j].x, batch[j].y);
+            }
         }
-        plot_line_to(verts[0].x, verts[0].y);
+        plot_line_to(first.x, first.y);
         plot_end();
     }
 
@@ -743,6 +2622,12 @@ struct R2DContext {
         if (index_count < 3)
             return;
         index += first_index;
+
+        if (!transform_.is_identity()) {
+            add_polygon_indexed_transformed(verts, index, index_count);
+            return;
+        }
+
         double first_x = (double)verts[index[0]].x * 256.0;
         double first_y = (double)verts[index[0]].y * 256.0;
         R2DFixed32 x0 = r2d_iround(first_x);
@@ -757,30 +2642,225 @@ struct R2DContext {
         add_edge(x0, y0, (int)first_x, (int)first_y);
     }
 
+    // Transform gathered vertices and convert them into fixed-point in one pass
+    void add_polygon_indexed_transformed(const R2DPoint* verts, const uint32_t* index,
+                                         size_t index_count) {
+        static constexpr size_t batch_size = 64;
+        R2DPoint batch[batch_size];
+        R2DFixed32 fixed_batch[batch_size * 2];
+        R2DFixed32 first_x = 0;
+        R2DFixed32 first_y = 0;
+        R2DFixed32 x0 = 0;
+        R2DFixed32 y0 = 0;
+
+        for (size_t i = 0; i < index_count; i += batch_size) {
+            size_t num_verts = r2d_min(index_count - i, batch_size);
+            for (size_t j = 0; j < num_verts; j++) {
+                batch[j] = verts[index[i + j]];
+            }
+            r2d_transform_points_fixed(fixed_batch, batch, num_verts, transform_);
+
+            size_t j = 0;
+            if (i == 0) {
+                first_x = x0 = fixed_batch[0];
+                first_y = y0 = fixed_batch[1];
+                j = 1;
+            }
+            for (; j < num_verts; j++) {
+                R2DFixed32 x1 = fixed_batch[j * 2 + 0];
+                R2DFixed32 y1 = fixed_batch[j * 2 + 1];
+                add_edge(x0, y0, x1, y1);
+                x0 = x1;
+                y0 = y1;
+            }
+        }
+        add_edge(x0, y0, first_x, first_y);
+    }
+
     void add_polyline(const R2DPoint* verts, size_t count, size_t first_vertex = 0,
                       bool close = false) {
-        if (count == 0)
+        if (count < 2)
             return;
-        if (count < 3) {
-            add_line(verts[0], verts[1]);
+        verts = transform_vertices(verts + first_vertex, count);
+        if (is_dashed()) {
+            add_dashed_polyline(verts, count, close);
             return;
         }
-        verts += first_vertex;
-        switch (line_join_) {
-            case R2DLineJoin::None: {
-                float x0 = verts[0].x;
-                float y0 = verts[0].y;
-                for (size_t i = 1; i < count; i++) {
-                    float x1 = verts[i].x;
-                    float y1 = verts[i].y;
-                    add_line(R2DPoint{x0, y0}, R2DPoint{x1, y1});
-                    x0 = x1;
-                    y0 = y1;
-                }
+        if (close)
+            add_closed_stroke(verts, count);
+        else
+            add_stroke(verts, count);
+    }
+
+    // Split the polyline into dashes. Each dash is stroked as its own sub-polyline so that joins
+    // inside of a dash are preserved, all of them are added into the same raster.
+    void add_dashed_polyline(const R2DPoint* verts, size_t count, bool close) {
+        size_t dash_index = 0;
+        float dash_remaining = dash_array_[0];
+        float offset = dash_offset_;
+
+        // Skip the dash offset
+        while (offset > 0.0f) {
+            if (offset < dash_remaining) {
+                dash_remaining -= offset;
                 break;
             }
-            case R2DLineJoin::Miter: {
-                // size_t join_count = ((size_t)count * 2ull) / 3ull;
+            offset -= dash_remaining;
+            dash_index = (dash_index + 1) % dash_array_.size();
+            dash_remaining = dash_array_[dash_index];
+        }
+
+        R2DVector<R2DPoint>& dash_points = tmp_dash_points_;
+        dash_points.clear();
+        if ((dash_index & 1) == 0)
+            dash_points.push_back(verts[0]);
+
+        // A closed polyline that starts inside of a dash holds the first dash back, the last
+        // dash continues into it through the start vertex
+        R2DVector<R2DPoint>& first_dash = tmp_first_dash_points_;
+        first_dash.clear();
+        bool hold_first_dash = close && (dash_index & 1) == 0;
+        bool dash_ended = false;
+
+        size_t num_segments = close ? count : count - 1;
+        for (size_t i = 0; i < num_segments; i++) {
+            R2DPoint p0 = verts[i];
+            R2DPoint p1 = verts[(i + 1) % count];
+            R2DPoint delta = p1 - p0;
+            float length = r2d_sqrt(delta.length_sq());
+            float pos = 0.0f;
+
+            if (length <= 0.0f)
+                continue;
+
+            while (length - pos > dash_remaining) {
+                pos += dash_remaining;
+                add_dash_point(p0 + delta * (pos / length));
+                if ((dash_index & 1) == 0) {
+                    if (hold_first_dash && !dash_ended) {
+                        for (size_t j = 0; j < dash_points.size(); j++)
+                            first_dash.push_back(dash_points[j]);
+                    } else {
+                        add_stroke(dash_points.data(), dash_points.size());
+                    }
+                    dash_points.clear();
+                }
+                dash_ended = true;
+                dash_index = (dash_index + 1) % dash_array_.size();
+                dash_remaining = dash_array_[dash_index];
+            }
+
+            dash_remaining -= length - pos;
+            if ((dash_index & 1) == 0)
+                add_dash_point(p1);
+        }
+
+        if (hold_first_dash && !dash_ended) {
+            // The whole outline is a single dash
+            dash_points.clear();
+            add_closed_stroke(verts, count);
+            return;
+        }
+        if ((dash_index & 1) == 0) {
+            for (size_t j = 0; j < first_dash.size(); j++)
+                add_dash_point(first_dash[j]);
+            add_stroke(dash_points.data(), dash_points.size());
+        } else {
+            add_stroke(first_dash.data(), first_dash.size());
+        }
+        dash_points.clear();
+    }
+
+    // Stroke a closed polyline given in device space. The outline gets a join at every vertex,
+    // the start vertex included, and is added as an outer and an inner contour of opposite
+    // directions.
+    void add_closed_stroke(const R2DPoint* verts, size_t count) {
+        // Drop repeated vertices, e.g. an explicitly closed input, they have no direction
+        R2DVector<R2DPoint>& points = tmp_stroke_points_;
+        points.clear();
+        for (size_t i = 0; i < count; i++) {
+            if (!points.empty() && points.back().x == verts[i].x && points.back().y == verts[i].y)
+                continue;
+            points.push_back(verts[i]);
+        }
+        while (points.size() > 1 && points.back().x == points[0].x &&
+               points.back().y == points[0].y)
+            points.pop_back();
+        count = points.size();
+        if (count < 3) {
+            if (count == 2)
+                add_stroke_line(points[0], points[1]);
+            return;
+        }
+
+        if (line_join_ == R2DLineJoin::None) {
+            for (size_t i = 0; i < count; i++)
+                add_stroke_line(points[i], points[(i + 1) % count]);
+            return;
+        }
+        if (line_join_ != R2DLineJoin::Miter)
+            return;
+
+        // Miter offset of each vertex, the sum of the unit normals of both segments scaled to
+        // reach the offset edges
+        R2DVector<R2DPoint>& offsets = tmp_line_normals_;
+        offsets.resize(count);
+        R2DPoint d0 = points[0] - points[count - 1];
+        R2DPoint n0 = R2DPoint{d0.y, -d0.x} * (1.0f / r2d_sqrt(d0.length_sq()));
+        for (size_t i = 0; i < count; i++) {
+            R2DPoint d1 = points[(i + 1) % count] - points[i];
+            R2DPoint n1 = R2DPoint{d1.y, -d1.x} * (1.0f / r2d_sqrt(d1.length_sq()));
+            R2DPoint miter = n0 + n1;
+            // Limit the miter of segments that almost fold back onto themselves
+            float cos_half = r2d_max(miter.x * n1.x + miter.y * n1.y, 0.25f);
+            offsets[i] = miter * (line_thickness_ / cos_half);
+            n0 = n1;
+        }
+
+        plot_move_to(points[0].x + offsets[0].x, points[0].y + offsets[0].y);
+        for (size_t i = 1; i < count; i++)
+            plot_line_to(points[i].x + offsets[i].x, points[i].y + offsets[i].y);
+        plot_line_to(points[0].x + offsets[0].x, points[0].y + offsets[0].y);
+        plot_end();
+
+        plot_move_to(points[0].x - offsets[0].x, points[0].y - offsets[0].y);
+        for (size_t i = count - 1; i > 0; i--)
+            plot_line_to(points[i].x - offsets[i].x, points[i].y - offsets[i].y);
+        plot_line_to(points[0].x - offsets[0].x, points[0].y - offsets[0].y);
+        plot_end();
+    }
+
+    // Append a point to the current dash, consecutive duplicated points are dropped
+    R2D_FORCEINLINE void add_dash_point(const R2DPoint& p) {
+        R2DVector<R2DPoint>& dash_points = tmp_dash_points_;
+        if (!dash_points.empty() && dash_points.back().x == p.x && dash_points.back().y == p.y)
+            return;
+        dash_points.push_back(p);
+    }
+
+    // Stroke a polyline given in device space with the current line join without dashing
+    void add_stroke(const R2DPoint* verts, size_t count) {
+        if (count < 2)
+            return;
+        if (count < 3) {
+            add_stroke_line(verts[0], verts[1]);
+            return;
+        }
+        switch (line_join_) {
+            case R2DLineJoin::None: {
+                float x0 = verts[0].x;
+                float y0 = verts[0].y;
+                for (size_t i = 1; i < count; i++) {
+                    float x1 = verts[i].x;
+                    float y1 = verts[i].y;
+                    add_stroke_line(R2DPoint{x0, y0}, R2DPoint{x1, y1});
+                    x0 = x1;
+                    y0 = y1;
+                }
+                break;
+            }
+            case R2DLineJoin::Miter: {
+                // size_t join_count = ((size_t)count * 2ull) / 3ull;
                 float x0 = verts[0].x;
                 float y0 = verts[0].y;
                 float x1 = verts[1].x;
@@ -1266,7 +3346,7 @@ struct R2DContext {
             R2DCell* cell = cells + iy0 * stride + ix0;
             // dy *= sign;
             cover = dy * sign;
-            area = ((fx0 + fx1) * cover) >> area_shift;
+            area = (((fx0 + fx1) * cover * sign) >> area_shift) * sign;
             add_cell = (cell->generation == generation);
             cell->generation = generation;
             cell->cover = cell->cover * add_cell + cover;
@@ -1279,7 +3359,7 @@ struct R2DContext {
 
             R2DCell* cell = &cells[iy0 * stride + ix0];
             cover = (aa_scale - fy0) * sign;
-            area = (two_fx * cover) >> area_shift;
+            area = ((two_fx * cover * sign) >> area_shift) * sign;
             add_cell = (cell->generation == generation);
             cell->generation = generation;
             cell->cover = cell->cover * add_cell + cover;
@@ -1287,7 +3367,7 @@ struct R2DContext {
 
             iy0 += inc_y;
             cover = aa_scale * sign;
-            area = (two_fx * cover) >> area_shift;
+            area = ((two_fx * cover * sign) >> area_shift) * sign;
 
             while (--scanline_count) {
                 cell = &cells[iy0 * stride + ix0];
@@ -1301,7 +3381,7 @@ struct R2DContext {
             if (fy1 != 0) {
                 cell = &cells[iy0 * stride + ix0];
                 cover = fy1 * sign;
-                area = (two_fx * cover) >> area_shift;
+                area = ((two_fx * cover * sign) >> area_shift) * sign;
                 add_cell = (cell->generation == generation);
                 cell->generation = generation;
                 cell->cover = cell->cover * add_cell + cover;
@@ -1354,7 +3434,7 @@ struct R2DContext {
                 if (next_x <= 256) {
                     R2DCell* cell = &scanline[ix0];
                     cover = (fy1 - fy0) * sign;
-                    area = ((acc_fx + next_x) * cover) >> area_shift;
+                    area = (((acc_fx + next_x) * cover * sign) >> area_shift) * sign;
 
                     if (cell->generation == generation) {
                         cover += cell->cover;
@@ -1388,7 +3468,7 @@ struct R2DContext {
 
                 R2DCell* cell = &scanline[ix0];
                 cover = (acc_fy - fy0) * sign;
-                area = ((acc_fx + aa_scale) * cover) >> area_shift;
+                area = (((acc_fx + aa_scale) * cover * sign) >> area_shift) * sign;
 
                 if (cell->generation == generation) {
                     cover += cell->cover;
@@ -1410,7 +3490,7 @@ struct R2DContext {
 
                     cell = &scanline[ix0];
                     cover = delta_y * sign;
-                    area = (aa_scale * cover) >> area_shift;
+                    area = ((aa_scale * cover * sign) >> area_shift) * sign;
 
                     if (cell->generation == generation) {
                         cover += cell->cover;
@@ -1429,7 +3509,7 @@ struct R2DContext {
                 if (acc_fy != 0 || scanline_count == 0) {
                     cell = &scanline[ix0];
                     cover = (fy1 - acc_fy) * sign;
-                    area = (acc_fx * cover) >> area_shift;
+                    area = ((acc_fx * cover * sign) >> area_shift) * sign;
 
                     if (cell->generation == generation) {
                         cover += cell->cover;
@@ -1473,7 +3553,7 @@ struct R2DContext {
                 if (next_fx <= 256) {
                     R2DCell* cell = &scanline[ix0];
                     cover = (fy1 - fy0) * sign;
-                    area = ((acc_fx + next_fx) * cover) >> area_shift;
+                    area = (((acc_fx + next_fx) * cover * sign) >> area_shift) * sign;
 
                     if (cell->generation == generation) {
                         cover += cell->cover;
@@ -1510,7 +3590,7 @@ struct R2DContext {
 
                 R2DCell* cell = &scanline[ix0];
                 cover = (acc_y - fy0) * sign;
-                area = ((acc_fx + aa_scale) * cover) >> area_shift;
+                area = (((acc_fx + aa_scale) * cover * sign) >> area_shift) * sign;
 
                 if (cell->generation == generation) {
                     cover += cell->cover;
@@ -1526,7 +3606,7 @@ struct R2DContext {
 
                 cell = &scanline[ix0];
                 cover = (fy1 - acc_y) * sign;
-                area = (acc_fx * cover) >> area_shift;
+                area = ((acc_fx * cover * sign) >> area_shift) * sign;
 
                 if (cell->generation == generation) {
                     cover += cell->cover;
@@ -1560,163 +3640,2083 @@ struct R2DContext {
     }
 
     inline void clear_render_target(int r, int g, int b, int a = 255) {
-        rt_->clear_raw(r << rt_bitpos_.r | g << rt_bitpos_.g | b << rt_bitpos_.b |
-                       a << rt_bitpos_.a);
+        clear_render_target(R2D_COLOR_CHANNEL_4(r, g, b, a));
     }
 
     inline void clear_render_target(const R2DColor& color) {
-        rt_->clear_raw(color.to_bytes(rt_->format_));
+        if (rt_->format_ == R2DPixelFormat::RGBA32F) {
+            rt_->clear_float(r2d_premultiply_ps(_mm_setr_ps(color.r, color.g, color.b, color.a)),
+                             thread_count_);
+            return;
+        }
+        clear_render_target(color.to_rgba8());
     }
 
+    // The color is straight alpha, it is premultiplied if the render target is premultiplied
     inline void clear_render_target(R2DColor8 color,
                                     R2DPixelFormat format = R2DPixelFormat::RGBA8) {
-        if (format == rt_->format_) {
-            rt_->clear_raw(color);
+        rt_->clear_raw(to_target_pixel(color, format), thread_count_);
+    }
+
+    // Fill a rectangle in device pixels with a color, like clear_render_target(). The edges are
+    // rounded to whole pixels and the rectangle is clipped to the clip rect.
+    void clear_rect(float x, float y, float w, float h, R2DColor8 color,
+                    R2DPixelFormat format = R2DPixelFormat::RGBA8) {
+        float x0 = r2d_max(x, clip_box_.x0);
+        float y0 = r2d_max(y, clip_box_.y0);
+        float x1 = r2d_min(x + w, clip_box_.x1);
+        float y1 = r2d_min(y + h, clip_box_.y1);
+        int32_t ix0 = r2d_max(r2d_iround(x0), 0);
+        int32_t iy0 = r2d_max(r2d_iround(y0), 0);
+        int32_t ix1 = r2d_min(r2d_iround(x1), (int32_t)rt_->width_);
+        int32_t iy1 = r2d_min(r2d_iround(y1), (int32_t)rt_->height_);
+        if (ix0 >= ix1 || iy0 >= iy1)
             return;
+        rt_->fill_raw(ix0, iy0, ix1 - ix0, iy1 - iy0, to_target_pixel(color, format),
+                      thread_count_);
+    }
+
+    // Convert a straight alpha color into the pixel value taken by R2DImage::clear_raw()
+    R2DColor8 to_target_pixel(R2DColor8 color, R2DPixelFormat format) const noexcept {
+        if (rt_->format_ == R2DPixelFormat::RGBA32F || rt_->format_ == R2DPixelFormat::NV12) {
+            // Premultiplied in float precision by float images, NV12 images ignore the alpha
+            R2DColor8 rgba = 0;
+            R2DFormatConverter(R2DPixelFormat::RGBA8, format).convert_row(&rgba, &color, 1);
+            return rgba;
         }
-        R2DColorBitShift rgba_bitpos = r2d_color_bitshift(format);
-        uint32_t r = (color >> rgba_bitpos.r) & 0xFF;
-        uint32_t g = (color >> rgba_bitpos.g) & 0xFF;
-        uint32_t b = (color >> rgba_bitpos.b) & 0xFF;
-        uint32_t a = (color >> rgba_bitpos.a) & 0xFF;
-        rt_->clear_raw(r << rt_bitpos_.r | g << rt_bitpos_.g | b << rt_bitpos_.b |
-                       a << rt_bitpos_.a);
+        R2DAlphaConversion alpha = is_enabled(R2DContextFlags::PremultipliedDstAlpha)
+                                       ? R2DAlphaConversion::Premultiply
+                                       : R2DAlphaConversion::None;
+        R2DColor8 pixel = 0;
+        R2DFormatConverter(rt_->format_, format, alpha).convert_row(&pixel, &color, 1);
+        return pixel;
     }
 
-    inline void render_raster() {
+    // Calls `fn` with the blend function object of the current blend mode
+    template <typename FnT>
+    R2D_FORCEINLINE void dispatch_blend_mode(FnT&& fn) {
+        if (is_enabled(R2DContextFlags::PremultipliedDstAlpha)) {
+            dispatch_blend_mode_premultiplied(fn);
+            return;
+        }
+
         switch (blend_mode_) {
             case R2DBlendMode::SrcOver:
-                render_raster_solid<R2DBlendSrcOver>();
+                dispatch_target_format<R2DBlendSrcOver>(fn);
                 break;
             case R2DBlendMode::SrcAtop:
-                render_raster_solid<R2DBlendSrcAtop>();
+                dispatch_target_format<R2DBlendSrcAtop>(fn);
                 break;
             case R2DBlendMode::SrcIn:
-                render_raster_solid<R2DBlendSrcIn>();
+                dispatch_target_format<R2DBlendSrcIn>(fn);
                 break;
             case R2DBlendMode::SrcOut:
-                render_raster_solid<R2DBlendSrcOut>();
+                dispatch_target_format<R2DBlendSrcOut>(fn);
                 break;
             case R2DBlendMode::SrcCopy:
+                dispatch_target_format<R2DBlendSrcCopy>(fn);
+                break;
+            case R2DBlendMode::DstOver:
+                dispatch_target_format<R2DBlendDstOver>(fn);
+                break;
+            case R2DBlendMode::DstAtop:
+                dispatch_target_format<R2DBlendDstAtop>(fn);
+                break;
+            case R2DBlendMode::DstIn:
+                dispatch_target_format<R2DBlendDstIn>(fn);
+                break;
+            case R2DBlendMode::DstOut:
+                dispatch_target_format<R2DBlendDstOut>(fn);
+                break;
+            case R2DBlendMode::DstCopy:
+                // The destination is kept as is
+                break;
+            case R2DBlendMode::Clear:
+                dispatch_target_format<R2DBlendClear>(fn);
+                break;
+            case R2DBlendMode::Xor:
+                dispatch_target_format<R2DBlendXor>(fn);
+                break;
+            case R2DBlendMode::Multiply:
+                dispatch_target_format<R2DBlendMultiply>(fn);
+                break;
+            case R2DBlendMode::Screen:
+                dispatch_target_format<R2DBlendScreen>(fn);
+                break;
+            case R2DBlendMode::Overlay:
+                dispatch_target_format<R2DBlendOverlay>(fn);
+                break;
+            case R2DBlendMode::Darken:
+                dispatch_target_format<R2DBlendDarken>(fn);
+                break;
+            case R2DBlendMode::Lighten:
+                dispatch_target_format<R2DBlendLighten>(fn);
+                break;
+            case R2DBlendMode::Difference:
+                dispatch_target_format<R2DBlendDifference>(fn);
                 break;
             default:
                 R2D_UNREACHABLE();
         }
     }
 
-    // Discard content in the raster. Should be used after drawing.
-    inline void discard_raster() {
-        if (!raster_)
-            return;
-        if (++raster_->current_gen_ == 0)
-            raster_->clear();
-        raster_->min_x_ = raster_->width_;
-        raster_->min_y_ = raster_->height_;
-        raster_->max_x_ = 0;
-        raster_->max_y_ = 0;
+    // Calls `fn` with `BlendFnT` bound to the pixel format of the render target
+    template <typename BlendFnT, typename FnT>
+    R2D_FORCEINLINE void dispatch_target_format(FnT&& fn) {
+        switch (rt_->format_) {
+            case R2DPixelFormat::RGBA8:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::RGBA8>{});
+                break;
+            case R2DPixelFormat::ARGB8:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::ARGB8>{});
+                break;
+            case R2DPixelFormat::BGRA8:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::BGRA8>{});
+                break;
+            case R2DPixelFormat::RGBX8:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::RGBX8>{});
+                break;
+            case R2DPixelFormat::BGRX8:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::BGRX8>{});
+                break;
+            case R2DPixelFormat::RGB565:
+                fn(R2DTargetBlend<BlendFnT, R2DPixelFormat::RGB565>{});
+                break;
+            default:
+                R2D_UNREACHABLE();
+        }
     }
 
-    template <typename BlendFnT>
-    void render_raster_solid() {
+    // Same as dispatch_blend_mode but for premultiplied render targets
+    template <typename FnT>
+    R2D_FORCEINLINE void dispatch_blend_mode_premultiplied(FnT&& fn) {
+        switch (blend_mode_) {
+            case R2DBlendMode::SrcOver:
+                dispatch_target_format<R2DBlendPremulSrcOver>(fn);
+                break;
+            case R2DBlendMode::SrcAtop:
+                dispatch_target_format<R2DBlendPremulSrcAtop>(fn);
+                break;
+            case R2DBlendMode::SrcIn:
+                dispatch_target_format<R2DBlendPremulSrcIn>(fn);
+                break;
+            case R2DBlendMode::SrcOut:
+                dispatch_target_format<R2DBlendPremulSrcOut>(fn);
+                break;
+            case R2DBlendMode::SrcCopy:
+                dispatch_target_format<R2DBlendPremulSrcCopy>(fn);
+                break;
+            case R2DBlendMode::DstOver:
+                dispatch_target_format<R2DBlendPremulDstOver>(fn);
+                break;
+            case R2DBlendMode::DstAtop:
+                dispatch_target_format<R2DBlendPremulDstAtop>(fn);
+                break;
+            case R2DBlendMode::DstIn:
+                dispatch_target_format<R2DBlendPremulDstIn>(fn);
+                break;
+            case R2DBlendMode::DstOut:
+                dispatch_target_format<R2DBlendPremulDstOut>(fn);
+                break;
+            case R2DBlendMode::DstCopy:
+                // The destination is kept as is
+                break;
+            case R2DBlendMode::Clear:
+                dispatch_target_format<R2DBlendPremulClear>(fn);
+                break;
+            case R2DBlendMode::Xor:
+                dispatch_target_format<R2DBlendPremulXor>(fn);
+                break;
+            case R2DBlendMode::Multiply:
+                dispatch_target_format<R2DBlendPremulMultiply>(fn);
+                break;
+            case R2DBlendMode::Screen:
+                dispatch_target_format<R2DBlendPremulScreen>(fn);
+                break;
+            case R2DBlendMode::Overlay:
+                dispatch_target_format<R2DBlendPremulOverlay>(fn);
+                break;
+            case R2DBlendMode::Darken:
+                dispatch_target_format<R2DBlendPremulDarken>(fn);
+                break;
+            case R2DBlendMode::Lighten:
+                dispatch_target_format<R2DBlendPremulLighten>(fn);
+                break;
+            case R2DBlendMode::Difference:
+                dispatch_target_format<R2DBlendPremulDifference>(fn);
+                break;
+            default:
+                R2D_UNREACHABLE();
+        }
+    }
+
+    inline void render_raster() {
         assert(source_ && "Source color is not specified");
+        if (blend_mode_ == R2DBlendMode::DstCopy)
+            return;
+        bool solid = blend_mode_ == R2DBlendMode::Clear || source_->type == R2DSourceType::Solid;
+        if (rt_->format_ == R2DPixelFormat::A8 && solid) {
+            render_raster_mask<R2DFetchBuffer>(nullptr);
+            return;
+        }
+        if (rt_->format_ == R2DPixelFormat::RGBA32F && solid) {
+            render_raster_float<R2DFetchBuffer>(nullptr);
+            return;
+        }
+        if (rt_->format_ == R2DPixelFormat::NV12 && solid) {
+            render_raster_nv12<R2DFetchBuffer>(nullptr);
+            return;
+        }
+        if (is_linear_blending() && solid) {
+            render_raster_linear<R2DFetchBuffer>(nullptr);
+            return;
+        }
+        if (blend_mode_ == R2DBlendMode::Clear) {
+            // The source is never read
+            auto render_clear = [this](auto blend_fn) {
+                render_raster_solid<decltype(blend_fn)>(0);
+            };
+            if (is_enabled(R2DContextFlags::PremultipliedDstAlpha))
+                dispatch_target_format<R2DBlendPremulClear>(render_clear);
+            else
+                dispatch_target_format<R2DBlendClear>(render_clear);
+            return;
+        }
+
+        switch (source_->type) {
+            case R2DSourceType::Solid:
+                dispatch_blend_mode([this](auto blend_fn) {
+                    render_raster_solid<decltype(blend_fn)>(source_->solid);
+                });
+                break;
+            case R2DSourceType::Linear: {
+                R2DFetchLinear fetcher(source_->linear, inverse_transform());
+                render_raster_source(fetcher);
+                break;
+            }
+            case R2DSourceType::Radial: {
+                R2DFetchRadial fetcher(source_->radial, inverse_transform());
+                render_raster_source(fetcher);
+                break;
+            }
+            case R2DSourceType::Conic: {
+                R2DFetchConic fetcher(source_->conic, inverse_transform());
+                render_raster_source(fetcher);
+                break;
+            }
+            case R2DSourceType::Pattern: {
+                R2DFetchPattern fetcher(source_->pattern, inverse_transform());
+                render_raster_source(fetcher);
+                break;
+            }
+            default:
+                R2D_UNREACHABLE();
+        }
+    }
+
+    // Render the raster with the source colors from `fetcher`
+    template <typename FetchT>
+    void render_raster_source(const FetchT& fetcher) {
+        if (rt_->format_ == R2DPixelFormat::A8) {
+            render_raster_mask(&fetcher);
+            return;
+        }
+        if (rt_->format_ == R2DPixelFormat::RGBA32F) {
+            render_raster_float(&fetcher);
+            return;
+        }
+        if (rt_->format_ == R2DPixelFormat::NV12) {
+            render_raster_nv12(&fetcher);
+            return;
+        }
+        if (is_linear_blending()) {
+            render_raster_linear(&fetcher);
+            return;
+        }
+        dispatch_blend_mode([&](auto blend_fn) {
+            render_raster_fetch<decltype(blend_fn)>(fetcher);
+        });
+    }
+
+    // Calls `fn` with the Porter-Duff operator of the current blend mode. Only the alpha formula
+    // of the operator is used on A8 render targets, the separable modes combine alpha the same
+    // way as source over.
+    template <typename FnT>
+    R2D_FORCEINLINE void dispatch_mask_blend_mode(FnT&& fn) {
+        switch (blend_mode_) {
+            case R2DBlendMode::SrcAtop:
+                fn(R2DBlendOpPremulSrcAtop{});
+                break;
+            case R2DBlendMode::SrcIn:
+                fn(R2DBlendOpPremulSrcIn{});
+                break;
+            case R2DBlendMode::SrcOut:
+                fn(R2DBlendOpPremulSrcOut{});
+                break;
+            case R2DBlendMode::SrcCopy:
+                fn(R2DBlendOpPremulSrcCopy{});
+                break;
+            case R2DBlendMode::DstOver:
+                fn(R2DBlendOpPremulDstOver{});
+                break;
+            case R2DBlendMode::DstAtop:
+                fn(R2DBlendOpPremulDstAtop{});
+                break;
+            case R2DBlendMode::DstIn:
+                fn(R2DBlendOpPremulDstIn{});
+                break;
+            case R2DBlendMode::DstOut:
+                fn(R2DBlendOpPremulDstOut{});
+                break;
+            case R2DBlendMode::DstCopy:
+                // The destination is kept as is
+                break;
+            case R2DBlendMode::Clear:
+                fn(R2DBlendOpPremulClear{});
+                break;
+            case R2DBlendMode::Xor:
+                fn(R2DBlendOpPremulXor{});
+                break;
+            case R2DBlendMode::SrcOver:
+            case R2DBlendMode::Multiply:
+            case R2DBlendMode::Screen:
+            case R2DBlendMode::Overlay:
+            case R2DBlendMode::Darken:
+            case R2DBlendMode::Lighten:
+            case R2DBlendMode::Difference:
+                fn(R2DBlendOpPremulSrcOver{});
+                break;
+            default:
+                R2D_UNREACHABLE();
+        }
+    }
+
+    // Render the raster into an A8 render target. The coverage is multiplied by the source alpha
+    // and combined with the existing mask by the blend mode, e.g. SrcCopy writes the mask itself,
+    // SrcOver adds to the mask and DstIn intersects with it. The source alpha is fetched from
+    // `fetcher`, or taken from the solid source if it is null.
+    template <typename FetchT>
+    void render_raster_mask(const FetchT* fetcher) {
+        dispatch_mask_blend_mode([&](auto blend_op) {
+            render_raster_mask_rows<decltype(blend_op)>(fetcher);
+        });
+    }
+
+    template <typename BlendOpT, typename FetchT>
+    void render_raster_mask_rows(const FetchT* fetcher) {
         assert(rt_ && "Render target is not specified");
         assert(raster_ && "Raster is not specified");
 
-        BlendFnT blend_fn{};
-        R2DColor8 src = source_->solid;
-        uint32_t src_color = 0xFFFFFF & src;
-        uint32_t src_alpha = (0xFF000000 & src) >> 24;
         uint32_t rt_width = rt_->width_;
         uint32_t raster_stride = raster_->stride_;
-        R2DPixel* image_data = (R2DPixel*)rt_->data_;
         R2DCell* cells = raster_->cells_;
         uint32_t current_raster_gen = raster_->current_gen_;
         uint32_t render_width = r2d_min(rt_width, raster_->width_);
         uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
-        uint32_t bitpos_r = rt_bitpos_.r;
-        uint32_t bitpos_g = rt_bitpos_.g;
-        uint32_t bitpos_b = rt_bitpos_.b;
-        uint32_t bitpos_a = rt_bitpos_.a;
         int32_t raster_min_x = raster_->min_x_;
         int32_t raster_min_y = raster_->min_y_;
         int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
         int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x)
+            return;
+
+        tmp_span_coverage_.resize(raster_max_x - raster_min_x);
+        uint8_t* coverage = tmp_span_coverage_.data() - raster_min_x;
+        R2DColor8* span = nullptr;
+        if (fetcher) {
+            tmp_span_colors_.resize(raster_max_x - raster_min_x);
+            span = tmp_span_colors_.data() - raster_min_x;
+        }
+        uint32_t src_alpha = fetcher ? 0 : source_->solid >> 24;
 
         for (int32_t y = raster_min_y; y < raster_max_y; y++) {
-            R2DColor8* image_row = &image_data[y * rt_width];
+            uint8_t* image_row = rt_->row(y);
             R2DCell* raster_row = &cells[y * raster_stride];
-            int effective_cover = 0;
+            if (fetcher)
+                fetcher->fetch(span + raster_min_x, raster_min_x, y, raster_max_x - raster_min_x);
+            accumulate_coverage(coverage, raster_row, raster_min_x, raster_max_x,
+                                current_raster_gen);
+            composite_mask_span<BlendOpT>(image_row, raster_min_x, raster_max_x, coverage, span,
+                                          src_alpha);
+        }
+    }
+
+    // Combine the source alpha weighted by `coverage` with a row of an A8 render target. The
+    // source alpha is taken from `src_span` if it is not null, otherwise `src_alpha` is used.
+    template <typename BlendOpT>
+    R2D_FORCEINLINE static void composite_mask_span(uint8_t* row, int32_t x0, int32_t x1,
+                                                    const uint8_t* coverage,
+                                                    const R2DColor8* src_span,
+                                                    uint32_t src_alpha) noexcept {
+        __m128i zero = _mm_setzero_si128();
+        __m128i full = _mm_set1_epi16(255);
+        __m128i src_alpha16 = _mm_set1_epi8((char)src_alpha);
+        int32_t x = x0;
+
+        // Blend one half of 16 pixels in 16-bit lanes
+        auto blend8 = [&](__m128i src, __m128i dst, __m128i cov) {
+            if constexpr (BlendOpT::fold_coverage)
+                return BlendOpT::alpha(r2d_fpmul_epu16(src, cov), dst);
+            __m128i result = _mm_min_epi16(BlendOpT::alpha(src, dst), full);
+            result = _mm_max_epi16(result, zero);
+            return _mm_add_epi16(r2d_fpmul_epu16(result, cov),
+                                 r2d_fpmul_epu16(dst, _mm_sub_epi16(full, cov)));
+        };
+
+        for (; x + 16 <= x1; x += 16) {
+            __m128i cov = _mm_loadu_si128((const __m128i*)(coverage + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(cov, zero)) == 0xFFFF)
+                continue;
+            __m128i src = src_alpha16;
+            if (src_span) {
+                const __m128i* colors = (const __m128i*)(src_span + x);
+                __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(colors), 24);
+                __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(colors + 1), 24);
+                __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(colors + 2), 24);
+                __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(colors + 3), 24);
+                src = _mm_packus_epi16(_mm_packs_epi32(a0, a1), _mm_packs_epi32(a2, a3));
+            }
+            __m128i dst = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i out_lo = blend8(_mm_unpacklo_epi8(src, zero), _mm_unpacklo_epi8(dst, zero),
+                                    _mm_unpacklo_epi8(cov, zero));
+            __m128i out_hi = blend8(_mm_unpackhi_epi8(src, zero), _mm_unpackhi_epi8(dst, zero),
+                                    _mm_unpackhi_epi8(cov, zero));
+            _mm_storeu_si128((__m128i*)(row + x), _mm_packus_epi16(out_lo, out_hi));
+        }
 
-            for (int32_t x = raster_min_x; x < raster_max_x; x++) {
-                R2DCell* cell = raster_row + x;
-                R2DColor8 dst = image_row[x];
-                int cover = 0;
-                int area = 0;
+        for (; x < x1; x++) {
+            int32_t cov = coverage[x];
+            if (cov == 0)
+                continue;
+            int32_t src = (int32_t)(src_span ? src_span[x] >> 24 : src_alpha);
+            int32_t dst = row[x];
+            int32_t result;
+            if constexpr (BlendOpT::fold_coverage) {
+                result = BlendOpT::alpha((int32_t)r2d_fpmul(src, cov), dst);
+            } else {
+                result = r2d_clamp(BlendOpT::alpha(src, dst), 0, 255);
+                result = (int32_t)(r2d_fpmul(result, cov) + r2d_fpmul(dst, 255 - cov));
+            }
+            row[x] = (uint8_t)r2d_clamp(result, 0, 255);
+        }
+    }
 
-                if (cell->generation >= current_raster_gen) {
-                    cover = cell->cover;
-                    area = cell->area;
-                }
+    // Calls `fn` with the float blend function object of the current blend mode
+    template <typename FnT>
+    R2D_FORCEINLINE void dispatch_float_blend_mode(FnT&& fn) {
+        switch (blend_mode_) {
+            case R2DBlendMode::SrcOver:
+                fn(R2DBlendFloatSrcOver{});
+                break;
+            case R2DBlendMode::SrcAtop:
+                fn(R2DBlendFloatSrcAtop{});
+                break;
+            case R2DBlendMode::SrcIn:
+                fn(R2DBlendFloatSrcIn{});
+                break;
+            case R2DBlendMode::SrcOut:
+                fn(R2DBlendFloatSrcOut{});
+                break;
+            case R2DBlendMode::SrcCopy:
+                fn(R2DBlendFloatSrcCopy{});
+                break;
+            case R2DBlendMode::DstOver:
+                fn(R2DBlendFloatDstOver{});
+                break;
+            case R2DBlendMode::DstAtop:
+                fn(R2DBlendFloatDstAtop{});
+                break;
+            case R2DBlendMode::DstIn:
+                fn(R2DBlendFloatDstIn{});
+                break;
+            case R2DBlendMode::DstOut:
+                fn(R2DBlendFloatDstOut{});
+                break;
+            case R2DBlendMode::DstCopy:
+                // The destination is kept as is
+                break;
+            case R2DBlendMode::Clear:
+                fn(R2DBlendFloatClear{});
+                break;
+            case R2DBlendMode::Xor:
+                fn(R2DBlendFloatXor{});
+                break;
+            case R2DBlendMode::Multiply:
+                fn(R2DBlendFloatMultiply{});
+                break;
+            case R2DBlendMode::Screen:
+                fn(R2DBlendFloatScreen{});
+                break;
+            case R2DBlendMode::Overlay:
+                fn(R2DBlendFloatOverlay{});
+                break;
+            case R2DBlendMode::Darken:
+                fn(R2DBlendFloatDarken{});
+                break;
+            case R2DBlendMode::Lighten:
+                fn(R2DBlendFloatLighten{});
+                break;
+            case R2DBlendMode::Difference:
+                fn(R2DBlendFloatDifference{});
+                break;
+            default:
+                R2D_UNREACHABLE();
+        }
+    }
 
-                effective_cover += cover;
-                int raster_mask = effective_cover - area;
-                if (raster_mask < 0)
-                    raster_mask = -raster_mask;
-                if (raster_mask > 255)
-                    raster_mask = 255;
+    // Render the raster into an RGBA32F render target. The source colors are fetched from
+    // `fetcher`, or taken from the solid source if it is null.
+    template <typename FetchT>
+    void render_raster_float(const FetchT* fetcher) {
+        dispatch_float_blend_mode([&](auto blend_fn) {
+            render_raster_float_rows<decltype(blend_fn)>(fetcher);
+        });
+    }
 
-                uint32_t msk_alpha = r2d_fpmul(raster_mask, src_alpha);
+    template <typename BlendFnT, typename FetchT>
+    void render_raster_float_rows(const FetchT* fetcher) {
+        assert(rt_ && "Render target is not specified");
+        assert(raster_ && "Raster is not specified");
 
-                // Un-swizzle color from their destination format to RGBA
-                uint32_t dst_r = (dst >> bitpos_r) & 0xFF;
-                uint32_t dst_g = (dst >> bitpos_g) & 0xFF;
-                uint32_t dst_b = (dst >> bitpos_b) & 0xFF;
-                uint32_t dst_a = (dst >> bitpos_a) & 0xFF;
-                R2DColor8 dst_color = dst_r | (dst_g << 8) | (dst_b << 16);
+        uint32_t rt_width = rt_->width_;
+        uint32_t raster_stride = raster_->stride_;
+        R2DCell* cells = raster_->cells_;
+        uint32_t current_raster_gen = raster_->current_gen_;
+        uint32_t render_width = r2d_min(rt_width, raster_->width_);
+        uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
+        int32_t raster_min_x = raster_->min_x_;
+        int32_t raster_min_y = raster_->min_y_;
+        int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
+        int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x)
+            return;
 
-                uint32_t out_alpha;
-                R2DColor8 out_color = blend_fn(src_color, msk_alpha, dst_color, dst_a, out_alpha);
+        tmp_span_coverage_.resize(raster_max_x - raster_min_x);
+        uint8_t* coverage = tmp_span_coverage_.data() - raster_min_x;
+        R2DColor8* span = nullptr;
+        if (fetcher) {
+            tmp_span_colors_.resize(raster_max_x - raster_min_x);
+            span = tmp_span_colors_.data() - raster_min_x;
+        }
+        __m128 src = r2d_premultiply_ps(r2d_color_to_ps(fetcher ? 0 : source_->solid));
 
-                // Swizzle the blending result back to their destination format
-                uint32_t out_r = (out_color >> 0) & 0xFF;
-                uint32_t out_g = (out_color >> 8) & 0xFF;
-                uint32_t out_b = (out_color >> 16) & 0xFF;
+        for (int32_t y = raster_min_y; y < raster_max_y; y++) {
+            float* image_row = rt_->row<float>(y);
+            R2DCell* raster_row = &cells[y * raster_stride];
+            if (fetcher)
+                fetcher->fetch(span + raster_min_x, raster_min_x, y, raster_max_x - raster_min_x);
+            accumulate_coverage(coverage, raster_row, raster_min_x, raster_max_x,
+                                current_raster_gen);
+            composite_float_span<BlendFnT>(image_row, raster_min_x, raster_max_x, coverage, span,
+                                           src);
+        }
+    }
 
-                image_row[x] = (out_r << bitpos_r) | (out_g << bitpos_g) | (out_b << bitpos_b) |
-                               (out_alpha << bitpos_a);
+    // Blend the source into a row of an RGBA32F render target, one pixel per register. The
+    // source is the premultiplied color `src` or the straight RGBA8 colors in `src_span`.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE static void composite_float_span(float* row, int32_t x0, int32_t x1,
+                                                     const uint8_t* coverage,
+                                                     const R2DColor8* src_span,
+                                                     __m128 src) noexcept {
+        BlendFnT blend_fn{};
+        __m128 coverage_scale = _mm_set1_ps(1.0f / 255.0f);
+
+        for (int32_t x = x0; x < x1; x++) {
+            uint32_t cov = coverage[x];
+            if (cov == 0)
+                continue;
+            if (src_span)
+                src = r2d_premultiply_ps(r2d_color_to_ps(src_span[x]));
+            float* pixel = row + (size_t)x * 4;
+            __m128 dst = _mm_loadu_ps(pixel);
+            __m128 out;
+            if (cov == 255) {
+                out = blend_fn(src, dst);
+            } else {
+                __m128 alpha = _mm_mul_ps(_mm_set1_ps((float)cov), coverage_scale);
+                if constexpr (BlendFnT::fold_coverage) {
+                    out = blend_fn(_mm_mul_ps(src, alpha), dst);
+                } else {
+                    out = blend_fn(src, dst);
+                    out = _mm_add_ps(dst, _mm_mul_ps(_mm_sub_ps(out, dst), alpha));
+                }
             }
+            _mm_storeu_ps(pixel, out);
         }
     }
 
+    // Render the raster into an NV12 render target. Rows are processed in pairs, the luma is
+    // blended per pixel and the chroma once per 2x2 block with the summed weights of the block.
+    // The source colors are fetched from `fetcher`, or taken from the solid source if it is null.
+    // The image is opaque, so every supported blend mode moves the pixels towards a color by a
+    // weight: SrcOver weights the source by coverage and alpha, SrcCopy by coverage only and
+    // Clear moves towards black by coverage.
+    template <typename FetchT>
+    void render_raster_nv12(const FetchT* fetcher) {
+        assert(rt_ && "Render target is not specified");
+        assert(raster_ && "Raster is not specified");
+        bool src_over = blend_mode_ == R2DBlendMode::SrcOver;
+        bool clear = blend_mode_ == R2DBlendMode::Clear;
+        bool supported = src_over || clear || blend_mode_ == R2DBlendMode::SrcCopy;
+        assert(supported && "NV12 render targets only support SrcOver, SrcCopy and Clear");
+        if (!supported)
+            return;
+        if (clear)
+            fetcher = nullptr; // The source is never read
+
+        uint32_t rt_width = rt_->width_;
+        uint32_t raster_stride = raster_->stride_;
+        R2DCell* cells = raster_->cells_;
+        uint32_t current_raster_gen = raster_->current_gen_;
+        uint32_t render_width = r2d_min(rt_width, raster_->width_);
+        uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
+        int32_t raster_min_x = raster_->min_x_;
+        int32_t raster_min_y = raster_->min_y_;
+        int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
+        int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x || raster_min_y >= raster_max_y)
+            return;
+
+        // Widen the span to whole 2x2 blocks, the extra columns keep a weight of 0
+        int32_t x0 = raster_min_x & ~1;
+        int32_t x1 = (raster_max_x + 1) & ~1;
+        int32_t span_width = x1 - x0;
+        tmp_span_coverage_.resize(span_width * 2);
+        std::memset(tmp_span_coverage_.data(), 0, span_width * 2);
+        uint8_t* weights[2] = {tmp_span_coverage_.data() - x0,
+                               tmp_span_coverage_.data() + span_width - x0};
+        R2DColor8* spans[2] = {};
+        if (fetcher) {
+            tmp_span_colors_.resize(span_width * 2);
+            std::memset(tmp_span_colors_.data(), 0, span_width * 2 * sizeof(R2DColor8));
+            spans[0] = tmp_span_colors_.data() - x0;
+            spans[1] = tmp_span_colors_.data() + span_width - x0;
+        }
+        R2DColor8 src_yuv = r2d_rgb_to_yuv(fetcher || clear ? 0 : source_->solid);
+        uint32_t src_alpha = fetcher ? 0 : src_over ? source_->solid >> 24 : 255;
+
+        for (int32_t y = raster_min_y & ~1; y < raster_max_y; y += 2) {
+            for (int32_t i = 0; i < 2; i++) {
+                int32_t row_y = y + i;
+                uint8_t* weight = weights[i];
+                if (row_y < raster_min_y || row_y >= raster_max_y) {
+                    std::memset(weight + raster_min_x, 0, raster_max_x - raster_min_x);
+                    continue;
+                }
+                accumulate_coverage(weight, &cells[row_y * raster_stride], raster_min_x,
+                                    raster_max_x, current_raster_gen);
+                if (fetcher) {
+                    R2DColor8* span = spans[i] + raster_min_x;
+                    fetcher->fetch(span, raster_min_x, row_y, raster_max_x - raster_min_x);
+                    for (int32_t x = raster_min_x; x < raster_max_x; x++) {
+                        R2DColor8 color = spans[i][x];
+                        if (src_over)
+                            weight[x] = (uint8_t)r2d_fpmul(weight[x], color >> 24);
+                        spans[i][x] = r2d_rgb_to_yuv(color);
+                    }
+                }
+                composite_luma_span(rt_->row(row_y), raster_min_x, raster_max_x, weight,
+                                    spans[i], src_yuv, src_alpha);
+            }
+            composite_chroma_span(rt_->chroma_row(y >> 1), x0, x1, weights, spans, src_yuv);
+        }
+    }
+
+    // Blend the luma of the source into a row of an NV12 render target. `weight` is the
+    // coverage, it is replaced with the coverage multiplied by `src_alpha` for a solid source.
+    // A fetched source has the weights already applied and its YUV colors in `src_span`.
+    R2D_FORCEINLINE static void composite_luma_span(uint8_t* row, int32_t x0, int32_t x1,
+                                                    uint8_t* weight, const R2DColor8* src_span,
+                                                    R2DColor8 src_yuv,
+                                                    uint32_t src_alpha) noexcept {
+        __m128i zero = _mm_setzero_si128();
+        __m128i full = _mm_set1_epi16(255);
+        __m128i alpha16 = _mm_set1_epi16((short)src_alpha);
+        __m128i luma16 = _mm_set1_epi16((short)(src_yuv & 0xFF));
+        __m128i luma_mask = _mm_set1_epi32(0xFF);
+        int32_t x = x0;
+
+        // Blend one half of 16 pixels in 16-bit lanes
+        auto blend8 = [&](__m128i src, __m128i dst, __m128i alpha) {
+            return _mm_add_epi16(r2d_fpmul_epu16(src, alpha),
+                                 r2d_fpmul_epu16(dst, _mm_sub_epi16(full, alpha)));
+        };
+
+        for (; x + 16 <= x1; x += 16) {
+            __m128i alpha = _mm_loadu_si128((const __m128i*)(weight + x));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(alpha, zero)) == 0xFFFF)
+                continue;
+            __m128i alpha_lo = _mm_unpacklo_epi8(alpha, zero);
+            __m128i alpha_hi = _mm_unpackhi_epi8(alpha, zero);
+            __m128i src_lo = luma16;
+            __m128i src_hi = luma16;
+            if (src_span) {
+                const __m128i* colors = (const __m128i*)(src_span + x);
+                __m128i y0 = _mm_and_si128(_mm_loadu_si128(colors), luma_mask);
+                __m128i y1 = _mm_and_si128(_mm_loadu_si128(colors + 1), luma_mask);
+                __m128i y2 = _mm_and_si128(_mm_loadu_si128(colors + 2), luma_mask);
+                __m128i y3 = _mm_and_si128(_mm_loadu_si128(colors + 3), luma_mask);
+                src_lo = _mm_packs_epi32(y0, y1);
+                src_hi = _mm_packs_epi32(y2, y3);
+            } else {
+                alpha_lo = r2d_fpmul_epu16(alpha_lo, alpha16);
+                alpha_hi = r2d_fpmul_epu16(alpha_hi, alpha16);
+                _mm_storeu_si128((__m128i*)(weight + x), _mm_packus_epi16(alpha_lo, alpha_hi));
+            }
+            __m128i dst = _mm_loadu_si128((const __m128i*)(row + x));
+            __m128i out_lo = blend8(src_lo, _mm_unpacklo_epi8(dst, zero), alpha_lo);
+            __m128i out_hi = blend8(src_hi, _mm_unpackhi_epi8(dst, zero), alpha_hi);
+            _mm_storeu_si128((__m128i*)(row + x), _mm_packus_epi16(out_lo, out_hi));
+        }
+
+        for (; x < x1; x++) {
+            uint32_t alpha = weight[x];
+            if (alpha == 0)
+                continue;
+            uint32_t src = src_yuv & 0xFF;
+            if (src_span) {
+                src = src_span[x] & 0xFF;
+            } else {
+                alpha = r2d_fpmul(alpha, src_alpha);
+                weight[x] = (uint8_t)alpha;
+            }
+            row[x] = (uint8_t)(r2d_fpmul(src, alpha) + r2d_fpmul(row[x], 255 - alpha));
+        }
+    }
+
+    // Blend the chroma of the source into a row of UV samples of an NV12 render target. Each
+    // sample covers two pixels of both rows in `weights`, the source chroma of every pixel is
+    // weighted by its coverage. `x0` and `x1` are even pixel coordinates.
+    R2D_FORCEINLINE static void composite_chroma_span(uint8_t* row, int32_t x0, int32_t x1,
+                                                      uint8_t* const* weights,
+                                                      R2DColor8* const* src_spans,
+                                                      R2DColor8 src_yuv) noexcept {
+        uint32_t src_u = (src_yuv >> 8) & 0xFF;
+        uint32_t src_v = (src_yuv >> 16) & 0xFF;
+        for (int32_t x = x0; x < x1; x += 2) {
+            uint32_t w0 = weights[0][x];
+            uint32_t w1 = weights[0][x + 1];
+            uint32_t w2 = weights[1][x];
+            uint32_t w3 = weights[1][x + 1];
+            uint32_t weight_sum = w0 + w1 + w2 + w3;
+            if (weight_sum == 0)
+                continue;
+            uint32_t u = src_u * weight_sum;
+            uint32_t v = src_v * weight_sum;
+            if (src_spans[0]) {
+                R2DColor8 c0 = src_spans[0][x];
+                R2DColor8 c1 = src_spans[0][x + 1];
+                R2DColor8 c2 = src_spans[1][x];
+                R2DColor8 c3 = src_spans[1][x + 1];
+                u = ((c0 >> 8) & 0xFF) * w0 + ((c1 >> 8) & 0xFF) * w1 +
+                    ((c2 >> 8) & 0xFF) * w2 + ((c3 >> 8) & 0xFF) * w3;
+                v = ((c0 >> 16) & 0xFF) * w0 + ((c1 >> 16) & 0xFF) * w1 +
+                    ((c2 >> 16) & 0xFF) * w2 + ((c3 >> 16) & 0xFF) * w3;
+            }
+            uint8_t* sample = row + x;
+            uint32_t dst_weight = 1020 - weight_sum;
+            sample[0] = (uint8_t)((u + sample[0] * dst_weight + 510) / 1020);
+            sample[1] = (uint8_t)((v + sample[1] * dst_weight + 510) / 1020);
+        }
+    }
+
+    bool is_linear_blending() const noexcept {
+        return is_enabled(R2DContextFlags::LinearBlending) &&
+               r2d_format_bytes_per_pixel(rt_->format_) == 4;
+    }
+
+    // The rectangle fast paths composite directly with the 8-bit blend functions
+    bool has_rect_fast_path() const noexcept {
+        return r2d_format_bytes_per_pixel(rt_->format_) == 4 &&
+               !is_enabled(R2DContextFlags::LinearBlending);
+    }
+
+    // Calls `fn` with the linear light blend function object of the current blend mode
+    template <typename FnT>
+    R2D_FORCEINLINE void dispatch_linear_blend_mode(FnT&& fn) {
+        switch (blend_mode_) {
+            case R2DBlendMode::SrcOver:
+                fn(R2DBlendLinearSrcOver{});
+                break;
+            case R2DBlendMode::SrcAtop:
+                fn(R2DBlendLinearSrcAtop{});
+                break;
+            case R2DBlendMode::SrcIn:
+                fn(R2DBlendLinearSrcIn{});
+                break;
+            case R2DBlendMode::SrcOut:
+                fn(R2DBlendLinearSrcOut{});
+                break;
+            case R2DBlendMode::SrcCopy:
+                fn(R2DBlendLinearSrcCopy{});
+                break;
+            case R2DBlendMode::DstOver:
+                fn(R2DBlendLinearDstOver{});
+                break;
+            case R2DBlendMode::DstAtop:
+                fn(R2DBlendLinearDstAtop{});
+                break;
+            case R2DBlendMode::DstIn:
+                fn(R2DBlendLinearDstIn{});
+                break;
+            case R2DBlendMode::DstOut:
+                fn(R2DBlendLinearDstOut{});
+                break;
+            case R2DBlendMode::DstCopy:
+                // The destination is kept as is
+                break;
+            case R2DBlendMode::Clear:
+                fn(R2DBlendLinearClear{});
+                break;
+            case R2DBlendMode::Xor:
+                fn(R2DBlendLinearXor{});
+                break;
+            case R2DBlendMode::Multiply:
+                fn(R2DBlendLinearMultiply{});
+                break;
+            case R2DBlendMode::Screen:
+                fn(R2DBlendLinearScreen{});
+                break;
+            case R2DBlendMode::Overlay:
+                fn(R2DBlendLinearOverlay{});
+                break;
+            case R2DBlendMode::Darken:
+                fn(R2DBlendLinearDarken{});
+                break;
+            case R2DBlendMode::Lighten:
+                fn(R2DBlendLinearLighten{});
+                break;
+            case R2DBlendMode::Difference:
+                fn(R2DBlendLinearDifference{});
+                break;
+            default:
+                R2D_UNREACHABLE();
+        }
+    }
+
+    // Render the raster into a 32-bit render target, blending in linear light. Four pixels at a
+    // time are decoded to premultiplied 12-bit linear values through the sRGB tables, blended in
+    // 16-bit lanes and encoded back.
+    template <typename FetchT>
+    void render_raster_linear(const FetchT* fetcher) {
+        dispatch_linear_blend_mode([&](auto blend_fn) {
+            using BlendFnT = decltype(blend_fn);
+            switch (rt_->format_) {
+                case R2DPixelFormat::RGBA8:
+                    render_raster_linear_rows<R2DTargetBlend<BlendFnT, R2DPixelFormat::RGBA8>>(
+                        fetcher);
+                    break;
+                case R2DPixelFormat::ARGB8:
+                    render_raster_linear_rows<R2DTargetBlend<BlendFnT, R2DPixelFormat::ARGB8>>(
+                        fetcher);
+                    break;
+                case R2DPixelFormat::BGRA8:
+                    render_raster_linear_rows<R2DTargetBlend<BlendFnT, R2DPixelFormat::BGRA8>>(
+                        fetcher);
+                    break;
+                case R2DPixelFormat::RGBX8:
+                    render_raster_linear_rows<R2DTargetBlend<BlendFnT, R2DPixelFormat::RGBX8>>(
+                        fetcher);
+                    break;
+                case R2DPixelFormat::BGRX8:
+                    render_raster_linear_rows<R2DTargetBlend<BlendFnT, R2DPixelFormat::BGRX8>>(
+                        fetcher);
+                    break;
+                default:
+                    R2D_UNREACHABLE();
+            }
+        });
+    }
+
+    template <typename BlendFnT, typename FetchT>
+    void render_raster_linear_rows(const FetchT* fetcher) {
+        assert(rt_ && "Render target is not specified");
+        assert(raster_ && "Raster is not specified");
+
+        uint32_t rt_width = rt_->width_;
+        uint32_t raster_stride = raster_->stride_;
+        R2DCell* cells = raster_->cells_;
+        uint32_t current_raster_gen = raster_->current_gen_;
+        uint32_t render_width = r2d_min(rt_width, raster_->width_);
+        uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
+        int32_t raster_min_x = raster_->min_x_;
+        int32_t raster_min_y = raster_->min_y_;
+        int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
+        int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x)
+            return;
+
+        tmp_span_coverage_.resize(raster_max_x - raster_min_x);
+        uint8_t* coverage = tmp_span_coverage_.data() - raster_min_x;
+        R2DColor8* span = nullptr;
+        if (fetcher) {
+            tmp_span_colors_.resize(raster_max_x - raster_min_x);
+            span = tmp_span_colors_.data() - raster_min_x;
+        }
+        bool premultiplied = is_enabled(R2DContextFlags::PremultipliedDstAlpha);
+        R2DLinearSolid solid{};
+        if (!fetcher && premultiplied)
+            init_linear_solid<BlendFnT, true>(solid, source_->solid);
+        else if (!fetcher)
+            init_linear_solid<BlendFnT, false>(solid, source_->solid);
+
+        for (int32_t y = raster_min_y; y < raster_max_y; y++) {
+            R2DColor8* image_row = rt_->row<R2DColor8>(y);
+            R2DCell* raster_row = &cells[y * raster_stride];
+            if (fetcher)
+                fetcher->fetch(span + raster_min_x, raster_min_x, y, raster_max_x - raster_min_x);
+            accumulate_coverage(coverage, raster_row, raster_min_x, raster_max_x,
+                                current_raster_gen);
+            if (!fetcher && premultiplied)
+                composite_linear_span<BlendFnT, true, true>(image_row, raster_min_x, raster_max_x,
+                                                            coverage, span, solid);
+            else if (!fetcher)
+                composite_linear_span<BlendFnT, true, false>(image_row, raster_min_x,
+                                                             raster_max_x, coverage, span, solid);
+            else if (premultiplied)
+                composite_linear_span<BlendFnT, false, true>(image_row, raster_min_x,
+                                                             raster_max_x, coverage, span, solid);
+            else
+                composite_linear_span<BlendFnT, false, false>(image_row, raster_min_x,
+                                                              raster_max_x, coverage, span, solid);
+        }
+    }
+
+    // Same as composite_span(), but blending in linear light. The last pixels of the span go
+    // through a group of four padded with uncovered pixels.
+    template <typename BlendFnT, bool SolidSource, bool Premultiplied>
+    R2D_FORCEINLINE static void composite_linear_span(R2DColor8* row, int32_t x0, int32_t x1,
+                                                      const uint8_t* coverage,
+                                                      const R2DColor8* src_span,
+                                                      const R2DLinearSolid& solid) noexcept {
+        __m128i src4 = solid.color;
+        int32_t x = x0;
+
+        for (; x + 4 <= x1; x += 4) {
+            uint32_t coverage4;
+            std::memcpy(&coverage4, coverage + x, sizeof(coverage4));
+            if (coverage4 == 0)
+                continue;
+            if constexpr (!SolidSource)
+                src4 = _mm_loadu_si128((const __m128i*)(src_span + x));
+            __m128i* pixels = (__m128i*)(row + x);
+            __m128i dst = _mm_loadu_si128(pixels);
+            _mm_storeu_si128(pixels, composite_linear4<BlendFnT, SolidSource, Premultiplied>(
+                                         dst, src4, solid, coverage4));
+        }
+
+        if (x < x1) {
+            size_t count = (size_t)(x1 - x);
+            uint32_t coverage4 = 0;
+            std::memcpy(&coverage4, coverage + x, count);
+            if (coverage4 == 0)
+                return;
+            R2DColor8 pixels[4]{};
+            std::memcpy(pixels, row + x, count * sizeof(R2DColor8));
+            if constexpr (!SolidSource) {
+                R2DColor8 colors[4]{};
+                std::memcpy(colors, src_span + x, count * sizeof(R2DColor8));
+                src4 = _mm_loadu_si128((const __m128i*)colors);
+            }
+            __m128i dst = _mm_loadu_si128((const __m128i*)pixels);
+            _mm_storeu_si128((__m128i*)pixels,
+                             composite_linear4<BlendFnT, SolidSource, Premultiplied>(
+                                 dst, src4, solid, coverage4));
+            std::memcpy(row + x, pixels, count * sizeof(R2DColor8));
+        }
+    }
+
+    // Blend four pixels in linear light. `dst` is in the render target format and `src` holds the
+    // straight sRGB source colors in RGBA order. Premultiplied targets are premultiplied in sRGB
+    // like everywhere else, their pixels are unpremultiplied before decoding and premultiplied
+    // again after encoding.
+    template <typename BlendFnT, bool SolidSource, bool Premultiplied>
+    R2D_FORCEINLINE static __m128i composite_linear4(__m128i dst, __m128i src,
+                                                     const R2DLinearSolid& solid,
+                                                     uint32_t coverage4) noexcept {
+        using BlendT = typename BlendFnT::blend_type;
+        constexpr R2DColorBitShift bitpos = BlendFnT::bitpos;
+        constexpr R2DColorBitShift rgba_bitpos = r2d_color_bitshift(R2DPixelFormat::RGBA8);
+        __m128i zero = _mm_setzero_si128();
+        __m128i alpha_mask = _mm_set1_epi32((int)(0xFFu << bitpos.a));
+        bool dst_opaque =
+            BlendFnT::opaque ||
+            _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(dst, alpha_mask), alpha_mask)) ==
+                0xFFFF;
+
+        if (coverage4 == 0xFFFFFFFF) {
+            if constexpr (std::is_same_v<BlendT, R2DBlendLinearSrcOver>) {
+                // Opaque sources are stored as is, the tables round trip every 8-bit value
+                __m128i src_alpha_mask = _mm_set1_epi32((int)0xFF000000);
+                __m128i src_alpha = _mm_and_si128(src, src_alpha_mask);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(src_alpha, src_alpha_mask)) == 0xFFFF)
+                    return swizzle4<BlendFnT>(src);
+            } else if constexpr (std::is_same_v<BlendT, R2DBlendLinearClear>) {
+                return swizzle4<BlendFnT>(zero);
+            }
+            if constexpr (SolidSource) {
+                if (dst_opaque) {
+                    alignas(16) uint32_t p[4];
+                    _mm_store_si128((__m128i*)p, dst);
+                    auto lookup = [&solid, bitpos](uint32_t c) {
+                        return (int)(solid.channels[0][(c >> bitpos.r) & 0xFF] |
+                                     solid.channels[1][(c >> bitpos.g) & 0xFF] |
+                                     solid.channels[2][(c >> bitpos.b) & 0xFF] | solid.alpha);
+                    };
+                    return _mm_setr_epi32(lookup(p[0]), lookup(p[1]), lookup(p[2]), lookup(p[3]));
+                }
+            }
+        }
+
+        __m128i src_lo = solid.linear;
+        __m128i src_hi = solid.linear;
+        if constexpr (!SolidSource)
+            r2d_srgb_to_linear4<false>(src, rgba_bitpos, src_lo, src_hi);
+
+        // Opaque pixels skip the alpha conversions
+        __m128i dst_lo;
+        __m128i dst_hi;
+        if (dst_opaque) {
+            r2d_srgb_to_linear4<true>(dst, bitpos, dst_lo, dst_hi);
+        } else if constexpr (Premultiplied) {
+            dst_lo = unswizzle16<BlendFnT>(_mm_unpacklo_epi8(dst, zero));
+            dst_hi = unswizzle16<BlendFnT>(_mm_unpackhi_epi8(dst, zero));
+            dst_lo = r2d_unpremultiply_epu16(dst_lo, r2d_broadcast_alpha_epi16(dst_lo));
+            dst_hi = r2d_unpremultiply_epu16(dst_hi, r2d_broadcast_alpha_epi16(dst_hi));
+            r2d_srgb_to_linear4<false>(_mm_packus_epi16(dst_lo, dst_hi), rgba_bitpos, dst_lo,
+                                       dst_hi);
+        } else {
+            r2d_srgb_to_linear4<false>(dst, bitpos, dst_lo, dst_hi);
+        }
+
+        __m128i out = blend_linear4<BlendFnT, Premultiplied>(src_lo, src_hi, dst_lo, dst_hi,
+                                                             coverage4);
+
+        // Uncovered pixels are left untouched
+        __m128i coverage = _mm_cvtsi32_si128((int)coverage4);
+        coverage = _mm_unpacklo_epi8(coverage, coverage);
+        coverage = _mm_unpacklo_epi16(coverage, coverage);
+        __m128i uncovered = _mm_cmpeq_epi32(coverage, zero);
+        return _mm_or_si128(_mm_and_si128(uncovered, dst), _mm_andnot_si128(uncovered, out));
+    }
+
+    // Blend four decoded pixels with the coverage in `coverage4` and encode the result into the
+    // render target format
+    template <typename BlendFnT, bool Premultiplied>
+    R2D_FORCEINLINE static __m128i blend_linear4(__m128i src_lo, __m128i src_hi, __m128i dst_lo,
+                                                 __m128i dst_hi, uint32_t coverage4) noexcept {
+        constexpr bool opaque = BlendFnT::opaque;
+        __m128i zero = _mm_setzero_si128();
+        BlendFnT blend_fn{};
+        __m128i out_lo;
+        __m128i out_hi;
+
+        if (coverage4 == 0xFFFFFFFF) {
+            out_lo = blend_fn(src_lo, dst_lo);
+            out_hi = blend_fn(src_hi, dst_hi);
+        } else {
+            // Spread the coverage of each pixel over its four channels
+            __m128i coverage = _mm_cvtsi32_si128((int)coverage4);
+            coverage = _mm_unpacklo_epi8(coverage, coverage);
+            coverage = _mm_unpacklo_epi16(coverage, coverage);
+            __m128i coverage_lo = r2d_linear_alpha_epu16(_mm_unpacklo_epi8(coverage, zero));
+            __m128i coverage_hi = r2d_linear_alpha_epu16(_mm_unpackhi_epi8(coverage, zero));
+            if constexpr (BlendFnT::fold_coverage) {
+                out_lo = blend_fn(r2d_linear_mul_epu16(src_lo, coverage_lo), dst_lo);
+                out_hi = blend_fn(r2d_linear_mul_epu16(src_hi, coverage_hi), dst_hi);
+            } else {
+                __m128i one = _mm_set1_epi16((short)r2d_linear_one);
+                __m128i inv_lo = _mm_sub_epi16(one, coverage_lo);
+                __m128i inv_hi = _mm_sub_epi16(one, coverage_hi);
+                out_lo = _mm_add_epi16(r2d_linear_mul_epu16(blend_fn(src_lo, dst_lo), coverage_lo),
+                                       r2d_linear_mul_epu16(dst_lo, inv_lo));
+                out_hi = _mm_add_epi16(r2d_linear_mul_epu16(blend_fn(src_hi, dst_hi), coverage_hi),
+                                       r2d_linear_mul_epu16(dst_hi, inv_hi));
+            }
+        }
+
+        __m128i out = r2d_linear_to_srgb4<opaque>(out_lo, out_hi, BlendFnT::bitpos);
+        __m128i alpha_mask = _mm_set1_epi32((int)(0xFFu << BlendFnT::bitpos.a));
+        if (Premultiplied && !opaque &&
+            _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(out, alpha_mask), alpha_mask)) !=
+                0xFFFF) {
+            out_lo = unswizzle16<BlendFnT>(_mm_unpacklo_epi8(out, zero));
+            out_hi = unswizzle16<BlendFnT>(_mm_unpackhi_epi8(out, zero));
+            out_lo = swizzle16<BlendFnT>(r2d_premultiply_epu16(out_lo));
+            out_hi = swizzle16<BlendFnT>(r2d_premultiply_epu16(out_hi));
+            return _mm_packus_epi16(out_lo, out_hi);
+        }
+        return out;
+    }
+
+    // Fill in `solid` for the straight sRGB color `src`. The channel tables are built by blending
+    // opaque gray pixels, which hold the same value in every channel.
+    template <typename BlendFnT, bool Premultiplied>
+    static void init_linear_solid(R2DLinearSolid& solid, R2DColor8 src) noexcept {
+        constexpr R2DColorBitShift bitpos = BlendFnT::bitpos;
+        constexpr R2DColorBitShift rgba_bitpos = r2d_color_bitshift(R2DPixelFormat::RGBA8);
+        __m128i src_hi;
+        solid.color = _mm_set1_epi32((int)src);
+        r2d_srgb_to_linear4<false>(solid.color, rgba_bitpos, solid.linear, src_hi);
+
+        for (uint32_t v = 0; v < 256; v += 4) {
+            alignas(16) uint32_t p[4];
+            __m128i gray = _mm_setr_epi32((int)v, (int)v + 1, (int)v + 2, (int)v + 3);
+            gray = _mm_mullo_epi16(gray, _mm_set1_epi32(0x0101));
+            gray = _mm_or_si128(gray, _mm_slli_epi32(gray, 16));
+            __m128i dst_lo;
+            __m128i dst_hi;
+            r2d_srgb_to_linear4<true>(gray, rgba_bitpos, dst_lo, dst_hi);
+            _mm_store_si128((__m128i*)p, blend_linear4<BlendFnT, Premultiplied>(
+                                             solid.linear, solid.linear, dst_lo, dst_hi,
+                                             0xFFFFFFFF));
+            for (uint32_t i = 0; i < 4; i++) {
+                solid.channels[0][v + i] = p[i] & (0xFFu << bitpos.r);
+                solid.channels[1][v + i] = p[i] & (0xFFu << bitpos.g);
+                solid.channels[2][v + i] = p[i] & (0xFFu << bitpos.b);
+                solid.alpha = p[i] & (0xFFu << bitpos.a);
+            }
+        }
+    }
+
+    // Inverse of the current transformation, used to map device pixels back to the source space
+    R2DAffine inverse_transform() const noexcept {
+        R2DAffine inv;
+        if (!transform_.invert(inv))
+            inv = R2DAffine(0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+        return inv;
+    }
+
+    // Discard content in the raster. Should be used after drawing.
+    inline void discard_raster() {
+        if (!raster_)
+            return;
+        if (++raster_->current_gen_ == 0)
+            raster_->clear();
+        raster_->min_x_ = raster_->width_;
+        raster_->min_y_ = raster_->height_;
+        raster_->max_x_ = 0;
+        raster_->max_y_ = 0;
+    }
+
+    template <typename BlendFnT>
+    void render_raster_solid(R2DColor8 src) {
+        assert(rt_ && "Render target is not specified");
+        assert(raster_ && "Raster is not specified");
+
+        BlendFnT blend_fn{};
+        uint32_t rt_width = rt_->width_;
+        uint32_t raster_stride = raster_->stride_;
+        R2DCell* cells = raster_->cells_;
+        uint32_t current_raster_gen = raster_->current_gen_;
+        uint32_t render_width = r2d_min(rt_width, raster_->width_);
+        uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
+        int32_t raster_min_x = raster_->min_x_;
+        int32_t raster_min_y = raster_->min_y_;
+        int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
+        int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x)
+            return;
+
+        tmp_span_coverage_.resize(raster_max_x - raster_min_x);
+        uint8_t* coverage = tmp_span_coverage_.data() - raster_min_x;
+
+        for (int32_t y = raster_min_y; y < raster_max_y; y++) {
+            R2DColor8* image_row = rt_->row<R2DColor8>(y);
+            R2DCell* raster_row = &cells[y * raster_stride];
+            accumulate_coverage(coverage, raster_row, raster_min_x, raster_max_x,
+                                current_raster_gen);
+            if constexpr (BlendFnT::format == R2DPixelFormat::RGB565) {
+                composite_span_rgb565<BlendFnT, true>(blend_fn, y, raster_min_x, raster_max_x,
+                                                      coverage, nullptr, src);
+                continue;
+            }
+            composite_span<BlendFnT, true>(blend_fn, image_row, raster_min_x, raster_max_x,
+                                           coverage, nullptr, src);
+        }
+    }
+
+    // Same as render_raster_solid but the source colors are fetched for every row from `fetcher`
+    template <typename BlendFnT, typename FetchT>
+    void render_raster_fetch(const FetchT& fetcher) {
+        assert(rt_ && "Render target is not specified");
+        assert(raster_ && "Raster is not specified");
+
+        BlendFnT blend_fn{};
+        uint32_t rt_width = rt_->width_;
+        uint32_t raster_stride = raster_->stride_;
+        R2DCell* cells = raster_->cells_;
+        uint32_t current_raster_gen = raster_->current_gen_;
+        uint32_t render_width = r2d_min(rt_width, raster_->width_);
+        uint32_t render_height = r2d_min(rt_->height_, raster_->height_);
+        int32_t raster_min_x = raster_->min_x_;
+        int32_t raster_min_y = raster_->min_y_;
+        int32_t raster_max_x = r2d_min(raster_->max_x_ + 1, (int32_t)render_width);
+        int32_t raster_max_y = r2d_min(raster_->max_y_ + 1, (int32_t)render_height);
+        if (raster_min_x >= raster_max_x)
+            return;
+
+        tmp_span_colors_.resize(raster_max_x - raster_min_x);
+        tmp_span_coverage_.resize(raster_max_x - raster_min_x);
+        R2DColor8* span = tmp_span_colors_.data() - raster_min_x;
+        uint8_t* coverage = tmp_span_coverage_.data() - raster_min_x;
+
+        for (int32_t y = raster_min_y; y < raster_max_y; y++) {
+            R2DColor8* image_row = rt_->row<R2DColor8>(y);
+            R2DCell* raster_row = &cells[y * raster_stride];
+            fetcher.fetch(span + raster_min_x, raster_min_x, y, raster_max_x - raster_min_x);
+            accumulate_coverage(coverage, raster_row, raster_min_x, raster_max_x,
+                                current_raster_gen);
+            if constexpr (BlendFnT::format == R2DPixelFormat::RGB565) {
+                composite_span_rgb565<BlendFnT, false>(blend_fn, y, raster_min_x, raster_max_x,
+                                                       coverage, span, 0);
+                continue;
+            }
+            composite_span<BlendFnT, false>(blend_fn, image_row, raster_min_x, raster_max_x,
+                                            coverage, span, 0);
+        }
+    }
+
+    // Sum up the cells of a raster row into 8-bit coverage values for [x0, x1)
+    R2D_FORCEINLINE static void accumulate_coverage(uint8_t* coverage, const R2DCell* raster_row,
+                                                    int32_t x0, int32_t x1,
+                                                    uint32_t current_raster_gen) noexcept {
+        int effective_cover = 0;
+        for (int32_t x = x0; x < x1; x++) {
+            const R2DCell* cell = raster_row + x;
+            int cover = 0;
+            int area = 0;
+
+            if (cell->generation >= current_raster_gen) {
+                cover = cell->cover;
+                area = cell->area;
+            }
+
+            effective_cover += cover;
+            int raster_mask = effective_cover - area;
+            if (raster_mask < 0)
+                raster_mask = -raster_mask;
+            if (raster_mask > 255)
+                raster_mask = 255;
+            coverage[x] = (uint8_t)raster_mask;
+        }
+    }
+
+    // Blend the source into a row of the render target with per-pixel coverage. The source is
+    // either the solid color `src` or the RGBA colors in `src_span`. Both `coverage` and
+    // `src_span` are indexed by the x coordinate.
+    template <typename BlendFnT, bool SolidSource>
+    R2D_FORCEINLINE void composite_span(BlendFnT& blend_fn, R2DPixel* row, int32_t x0, int32_t x1,
+                                        const uint8_t* coverage, const R2DColor8* src_span,
+                                        R2DColor8 src) noexcept {
+        __m128i src4 = _mm_set1_epi32((int)src);
+        int32_t x = x0;
+
+        for (; x + 4 <= x1; x += 4) {
+            uint32_t coverage4;
+            std::memcpy(&coverage4, coverage + x, sizeof(coverage4));
+            if (coverage4 == 0)
+                continue;
+            if constexpr (!SolidSource)
+                src4 = _mm_loadu_si128((const __m128i*)(src_span + x));
+            composite4(blend_fn, row + x, src4, coverage4);
+        }
+
+        for (; x < x1; x++) {
+            R2DColor8 color = SolidSource ? src : src_span[x];
+            row[x] = blend_pixel(blend_fn, row[x], color & 0xFFFFFF, color >> 24, coverage[x]);
+        }
+    }
+
+    // composite_span for RGB565 render targets. The covered part of row `y` is unpacked into an
+    // opaque RGBA row, blended, then packed back with optional dithering. Uncovered pixels are
+    // not written.
+    template <typename BlendFnT, bool SolidSource>
+    void composite_span_rgb565(BlendFnT& blend_fn, int32_t y, int32_t x0, int32_t x1,
+                               const uint8_t* coverage, const R2DColor8* src_span,
+                               R2DColor8 src) noexcept {
+        uint16_t* row = rt_->row<uint16_t>(y);
+        size_t count = (size_t)(x1 - x0);
+        tmp_target_row_.resize(count);
+        R2DColor8* pixels = tmp_target_row_.data() - x0;
+        r2d_unpack_rgb565_row(pixels + x0, row + x0, count);
+        composite_span<BlendFnT, SolidSource>(blend_fn, pixels, x0, x1, coverage, src_span, src);
+
+        // Offsets of the four pixels starting at x0 in the 4x4 threshold matrix, scaled to the
+        // truncated bits of each channel
+        if (!is_enabled(R2DContextFlags::Dithering)) {
+            r2d_pack_rgb565_row<false>(row + x0, pixels + x0, coverage + x0, count, nullptr);
+            return;
+        }
+        R2DColor8 dither[4];
+        for (int32_t i = 0; i < 4; i++) {
+            uint32_t threshold = r2d_bayer4x4[(y & 3) * 4 + ((x0 + i) & 3)];
+            dither[i] = R2D_COLOR_CHANNEL_4(threshold >> 1, threshold >> 2, threshold >> 1, 0);
+        }
+        r2d_pack_rgb565_row<true>(row + x0, pixels + x0, coverage + x0, count, dither);
+    }
+
+    // Blend four pixels of the render target, `coverage4` holds the coverage of each pixel in
+    // one byte. Handles the cases where the result is known without blending.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE void composite4(BlendFnT& blend_fn, R2DPixel* pixels, __m128i src,
+                                    uint32_t coverage4) const noexcept {
+        using BlendT = typename BlendFnT::blend_type;
+        __m128i dst = _mm_loadu_si128((const __m128i*)pixels);
+
+        if constexpr (std::is_same_v<BlendT, R2DBlendDstOver> ||
+                      std::is_same_v<BlendT, R2DBlendPremulDstOver>) {
+            // Nothing shows through an opaque destination
+            if constexpr (BlendFnT::opaque)
+                return;
+            __m128i dst_alpha_mask = _mm_set1_epi32((int)(0xFFu << BlendFnT::bitpos.a));
+            __m128i dst_alpha = _mm_and_si128(dst, dst_alpha_mask);
+            if (_mm_movemask_epi8(_mm_cmpeq_epi32(dst_alpha, dst_alpha_mask)) == 0xFFFF)
+                return;
+        }
+
+        if (coverage4 == 0xFFFFFFFF) {
+            if constexpr (std::is_same_v<BlendT, R2DBlendSrcOver> ||
+                          std::is_same_v<BlendT, R2DBlendPremulSrcOver>) {
+                __m128i src_alpha_mask = _mm_set1_epi32((int)0xFF000000);
+                __m128i src_alpha = _mm_and_si128(src, src_alpha_mask);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(src_alpha, src_alpha_mask)) == 0xFFFF) {
+                    _mm_storeu_si128((__m128i*)pixels, swizzle4<BlendFnT>(src));
+                    return;
+                }
+            } else if constexpr (std::is_same_v<BlendT, R2DBlendSrcCopy>) {
+                _mm_storeu_si128((__m128i*)pixels, swizzle4<BlendFnT>(src));
+                return;
+            } else if constexpr (std::is_same_v<BlendT, R2DBlendPremulSrcCopy>) {
+                __m128i zero = _mm_setzero_si128();
+                __m128i src_lo = r2d_premultiply_epu16(_mm_unpacklo_epi8(src, zero));
+                __m128i src_hi = r2d_premultiply_epu16(_mm_unpackhi_epi8(src, zero));
+                src_lo = swizzle16<BlendFnT>(src_lo);
+                src_hi = swizzle16<BlendFnT>(src_hi);
+                _mm_storeu_si128((__m128i*)pixels, _mm_packus_epi16(src_lo, src_hi));
+                return;
+            } else if constexpr (std::is_same_v<BlendT, R2DBlendClear> ||
+                                 std::is_same_v<BlendT, R2DBlendPremulClear>) {
+                _mm_storeu_si128((__m128i*)pixels, swizzle4<BlendFnT>(_mm_setzero_si128()));
+                return;
+            }
+        }
+
+        _mm_storeu_si128((__m128i*)pixels, blend4(blend_fn, dst, src, coverage4));
+    }
+
+    // SIMD variant of blend_pixel for four pixels. `dst` is in the render target format, `src` is
+    // in RGBA order.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE __m128i blend4(BlendFnT& blend_fn, __m128i dst, __m128i src,
+                                   uint32_t coverage4) const noexcept {
+        __m128i zero = _mm_setzero_si128();
+
+        // Spread the coverage of each pixel over its four channels
+        __m128i coverage = _mm_cvtsi32_si128((int)coverage4);
+        coverage = _mm_unpacklo_epi8(coverage, coverage);
+        coverage = _mm_unpacklo_epi16(coverage, coverage);
+        __m128i coverage_lo = _mm_unpacklo_epi8(coverage, zero);
+        __m128i coverage_hi = _mm_unpackhi_epi8(coverage, zero);
+
+        __m128i src_lo = _mm_unpacklo_epi8(src, zero);
+        __m128i src_hi = _mm_unpackhi_epi8(src, zero);
+        __m128i dst_lo = unswizzle16<BlendFnT>(_mm_unpacklo_epi8(dst, zero));
+        __m128i dst_hi = unswizzle16<BlendFnT>(_mm_unpackhi_epi8(dst, zero));
+        __m128i out_lo;
+        __m128i out_hi;
+
+        if constexpr (BlendFnT::opaque && std::is_same_v<typename BlendFnT::blend_type,
+                                                         R2DBlendSrcOver>) {
+            // The destination alpha is always 255, source over is a single lerp
+            __m128i full = _mm_set1_epi16(255);
+            __m128i alpha_lo = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(src_lo), coverage_lo);
+            __m128i alpha_hi = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(src_hi), coverage_hi);
+            out_lo = _mm_add_epi16(r2d_fpmul_epu16(src_lo, alpha_lo),
+                                   r2d_fpmul_epu16(dst_lo, _mm_sub_epi16(full, alpha_lo)));
+            out_hi = _mm_add_epi16(r2d_fpmul_epu16(src_hi, alpha_hi),
+                                   r2d_fpmul_epu16(dst_hi, _mm_sub_epi16(full, alpha_hi)));
+        } else if constexpr (BlendFnT::premultiplied) {
+            // The coverage scales every channel of the premultiplied colors
+            __m128i inv_coverage_lo = _mm_sub_epi16(_mm_set1_epi16(255), coverage_lo);
+            __m128i inv_coverage_hi = _mm_sub_epi16(_mm_set1_epi16(255), coverage_hi);
+            src_lo = r2d_premultiply_epu16(src_lo);
+            src_hi = r2d_premultiply_epu16(src_hi);
+            if constexpr (BlendFnT::fold_coverage) {
+                out_lo = blend_fn(r2d_fpmul_epu16(src_lo, coverage_lo), dst_lo);
+                out_hi = blend_fn(r2d_fpmul_epu16(src_hi, coverage_hi), dst_hi);
+            } else {
+                out_lo = _mm_add_epi16(r2d_fpmul_epu16(blend_fn(src_lo, dst_lo), coverage_lo),
+                                       r2d_fpmul_epu16(dst_lo, inv_coverage_lo));
+                out_hi = _mm_add_epi16(r2d_fpmul_epu16(blend_fn(src_hi, dst_hi), coverage_hi),
+                                       r2d_fpmul_epu16(dst_hi, inv_coverage_hi));
+            }
+        } else if constexpr (BlendFnT::fold_coverage) {
+            src_lo = r2d_set_alpha_epi16(src_lo, r2d_fpmul_epu16(src_lo, coverage_lo));
+            src_hi = r2d_set_alpha_epi16(src_hi, r2d_fpmul_epu16(src_hi, coverage_hi));
+            out_lo = blend_fn(src_lo, dst_lo);
+            out_hi = blend_fn(src_hi, dst_hi);
+        } else {
+            // Fully covered pixels take the blended color as is
+            __m128i full = _mm_set1_epi16(255);
+            __m128i blend_lo = blend_fn(src_lo, dst_lo);
+            __m128i blend_hi = blend_fn(src_hi, dst_hi);
+            __m128i full_lo = _mm_cmpeq_epi16(coverage_lo, full);
+            __m128i full_hi = _mm_cmpeq_epi16(coverage_hi, full);
+            out_lo = r2d_blend_coverage_epu16(blend_lo, dst_lo, coverage_lo);
+            out_hi = r2d_blend_coverage_epu16(blend_hi, dst_hi, coverage_hi);
+            out_lo = _mm_or_si128(_mm_and_si128(full_lo, blend_lo),
+                                  _mm_andnot_si128(full_lo, out_lo));
+            out_hi = _mm_or_si128(_mm_and_si128(full_hi, blend_hi),
+                                  _mm_andnot_si128(full_hi, out_hi));
+        }
+
+        // Uncovered pixels are left untouched
+        __m128i out = _mm_packus_epi16(swizzle16<BlendFnT>(out_lo), swizzle16<BlendFnT>(out_hi));
+        __m128i uncovered = _mm_cmpeq_epi32(coverage, zero);
+        return _mm_or_si128(_mm_and_si128(uncovered, dst), _mm_andnot_si128(uncovered, out));
+    }
+
+    // Move the 16-bit channels of two pixels from the render target format into RGBA order. The
+    // alpha of targets without an alpha channel is 255.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE static __m128i unswizzle16(__m128i pixels) noexcept {
+        constexpr int control = BlendFnT::unswizzle_control;
+        if constexpr (control != _MM_SHUFFLE(3, 2, 1, 0))
+            pixels = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, control), control);
+        if constexpr (BlendFnT::opaque)
+            pixels = r2d_set_alpha_epi16(pixels, _mm_set1_epi16(255));
+        return pixels;
+    }
+
+    // Move the 16-bit channels of two RGBA pixels into the render target format. The unused byte
+    // of targets without an alpha channel is set to 255.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE static __m128i swizzle16(__m128i pixels) noexcept {
+        constexpr int control = BlendFnT::swizzle_control;
+        if constexpr (BlendFnT::opaque)
+            pixels = r2d_set_alpha_epi16(pixels, _mm_set1_epi16(255));
+        if constexpr (control != _MM_SHUFFLE(3, 2, 1, 0))
+            pixels = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, control), control);
+        return pixels;
+    }
+
+    // Move the channels of four RGBA pixels into the render target format
+    template <typename BlendFnT>
+    R2D_FORCEINLINE static __m128i swizzle4(__m128i pixels) noexcept {
+        constexpr R2DColorBitShift bitpos = BlendFnT::bitpos;
+        if constexpr (BlendFnT::opaque)
+            pixels = _mm_or_si128(pixels, _mm_set1_epi32((int)0xFF000000));
+        if constexpr (bitpos.r == 0 && bitpos.g == 8 && bitpos.b == 16 && bitpos.a == 24) {
+            return pixels;
+        } else if constexpr (bitpos.r == 16 && bitpos.g == 8 && bitpos.b == 0 && bitpos.a == 24) {
+            // Swap red and blue
+            __m128i rb = _mm_and_si128(pixels, _mm_set1_epi32(0x00FF00FF));
+            __m128i ga = _mm_andnot_si128(_mm_set1_epi32(0x00FF00FF), pixels);
+            return _mm_or_si128(ga, _mm_or_si128(_mm_srli_epi32(rb, 16), _mm_slli_epi32(rb, 16)));
+        } else {
+            __m128i mask = _mm_set1_epi32(0xFF);
+            __m128i r = _mm_and_si128(pixels, mask);
+            __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+            __m128i b = _mm_and_si128(_mm_srli_epi32(pixels, 16), mask);
+            __m128i a = _mm_srli_epi32(pixels, 24);
+            __m128i rg = _mm_or_si128(_mm_slli_epi32(r, bitpos.r), _mm_slli_epi32(g, bitpos.g));
+            __m128i ba = _mm_or_si128(_mm_slli_epi32(b, bitpos.b), _mm_slli_epi32(a, bitpos.a));
+            return _mm_or_si128(rg, ba);
+        }
+    }
+
+    // Blend a single pixel of the render target with the source color weighted by `coverage`
+    template <typename BlendFnT>
+    R2D_FORCEINLINE R2DColor8 blend_pixel(BlendFnT& blend_fn, R2DColor8 dst, R2DColor8 src_color,
+                                          uint32_t src_alpha, uint32_t coverage) const noexcept {
+        constexpr R2DColorBitShift bitpos = BlendFnT::bitpos;
+        if (coverage == 0)
+            return dst;
+
+        // Un-swizzle color from their destination format to RGBA
+        uint32_t dst_r = (dst >> bitpos.r) & 0xFF;
+        uint32_t dst_g = (dst >> bitpos.g) & 0xFF;
+        uint32_t dst_b = (dst >> bitpos.b) & 0xFF;
+        uint32_t dst_a = BlendFnT::opaque ? 255 : (dst >> bitpos.a) & 0xFF;
+        R2DColor8 dst_color = dst_r | (dst_g << 8) | (dst_b << 16);
+
+        uint32_t out_alpha;
+        R2DColor8 out_color;
+        if constexpr (BlendFnT::opaque && std::is_same_v<typename BlendFnT::blend_type,
+                                                         R2DBlendSrcOver>) {
+            // The destination alpha is always 255, source over is a single lerp
+            uint32_t alpha = r2d_fpmul(coverage, src_alpha);
+            out_color =
+                r2d_rgb_alphamult(src_color, alpha) + r2d_rgb_alphamult(dst_color, 255 - alpha);
+            out_alpha = 255;
+        } else if constexpr (BlendFnT::premultiplied) {
+            // Both colors are premultiplied, the coverage scales every channel
+            R2DColor8 src = r2d_premultiply(src_color | (src_alpha << 24));
+            R2DColor8 dst_rgba = dst_color | (dst_a << 24);
+            R2DColor8 out;
+            if constexpr (BlendFnT::fold_coverage) {
+                out = blend_fn(r2d_rgba_alphamult(src, coverage), dst_rgba);
+            } else {
+                out = blend_fn(src, dst_rgba);
+                if (coverage != 255) {
+                    out = r2d_rgba_alphamult(out, coverage) +
+                          r2d_rgba_alphamult(dst_rgba, 255 - coverage);
+                }
+            }
+            out_color = out & 0xFFFFFF;
+            out_alpha = out >> 24;
+        } else if constexpr (BlendFnT::fold_coverage) {
+            uint32_t msk_alpha = r2d_fpmul(coverage, src_alpha);
+            out_color = blend_fn(src_color, msk_alpha, dst_color, dst_a, out_alpha);
+        } else {
+            out_color = blend_fn(src_color, src_alpha, dst_color, dst_a, out_alpha);
+            if (coverage != 255) {
+                out_color = r2d_blend_coverage(out_color, out_alpha, dst_color, dst_a, coverage,
+                                               out_alpha);
+            }
+        }
+
+        // Swizzle the blending result back to their destination format
+        uint32_t out_r = (out_color >> 0) & 0xFF;
+        uint32_t out_g = (out_color >> 8) & 0xFF;
+        uint32_t out_b = (out_color >> 16) & 0xFF;
+        if constexpr (BlendFnT::opaque)
+            out_alpha = 255;
+
+        return (out_r << bitpos.r) | (out_g << bitpos.g) | (out_b << bitpos.b) |
+               (out_alpha << bitpos.a);
+    }
+
+    // Blend a span of pixels that share the same coverage value
+    template <typename BlendFnT>
+    R2D_FORCEINLINE void blend_span(BlendFnT& blend_fn, R2DPixel* row, int32_t x0, int32_t x1,
+                                    R2DColor8 src_color, uint32_t src_alpha,
+                                    uint32_t coverage) noexcept {
+        if (coverage == 0)
+            return;
+        R2DColor8 src = src_color | (src_alpha << 24);
+        __m128i src4 = _mm_set1_epi32((int)src);
+        uint32_t coverage4 = coverage * 0x01010101u;
+        int32_t x = x0;
+        for (; x + 4 <= x1; x += 4) {
+            composite4(blend_fn, row + x, src4, coverage4);
+        }
+        for (; x < x1; x++) {
+            row[x] = blend_pixel(blend_fn, row[x], src_color, src_alpha, coverage);
+        }
+    }
+
+    // Clip a box against the clip rectangle and the render target. Returns false if the result is
+    // empty.
+    R2D_FORCEINLINE bool clip_to_target(R2DBox& box) const noexcept {
+        box.x0 = r2d_max(box.x0, r2d_max(clip_box_.x0, 0.0f));
+        box.y0 = r2d_max(box.y0, r2d_max(clip_box_.y0, 0.0f));
+        box.x1 = r2d_min(box.x1, r2d_min(clip_box_.x1, (float)rt_->width_));
+        box.y1 = r2d_min(box.y1, r2d_min(clip_box_.y1, (float)rt_->height_));
+        return box.x0 < box.x1 && box.y0 < box.y1;
+    }
+
+    // Fill an axis-aligned rectangle directly into the render target without going through the
+    // raster. Edge coverage is computed from the same 24.8 fixed-point coordinates the raster uses.
+    template <typename BlendFnT>
+    void render_rect_solid(R2DBox box, R2DColor8 src) noexcept {
+        assert(rt_ && "Render target is not specified");
+        if (!clip_to_target(box))
+            return;
+
+        BlendFnT blend_fn{};
+        R2DFixedBox fixed_box = r2d_fixed_box(box);
+        blend_rect_rows(blend_fn, fixed_box, fixed_box.y0 >> 8, (fixed_box.y1 + 255) >> 8, src);
+    }
+
+    // Fill a list of rectangles with their own colors. The rectangles are binned into horizontal
+    // bands with a counting sort and filled band by band, which keeps the touched rows of the
+    // render target in cache. The submission order is preserved within a band so overlapping
+    // rectangles are blended in the same order as they were specified.
+    template <typename BlendFnT>
+    void render_rects_solid(const R2DRect* rects, const R2DColor8* colors, size_t count) {
+        static constexpr int32_t band_shift = 6;
+        assert(rt_ && "Render target is not specified");
+
+        BlendFnT blend_fn{};
+        uint32_t num_bands = (rt_->height_ + (1u << band_shift) - 1) >> band_shift;
+        R2DVector<R2DFixedBox>& boxes = tmp_rect_boxes_;
+        R2DVector<uint32_t>& band_offsets = tmp_rect_band_offsets_;
+        R2DVector<uint32_t>& band_items = tmp_rect_band_items_;
+
+        boxes.resize(count);
+        band_offsets.resize(num_bands + 1);
+        std::memset(band_offsets.data(), 0, (num_bands + 1) * sizeof(uint32_t));
+
+        // Count how many rectangles touch each band
+        size_t num_items = 0;
+        for (size_t i = 0; i < count; i++) {
+            R2DBox box{rects[i].x, rects[i].y, rects[i].x + rects[i].w, rects[i].y + rects[i].h};
+            transform_box(box);
+            if (!clip_to_target(box)) {
+                boxes[i] = R2DFixedBox{};
+                continue;
+            }
+            // Boxes thinner than the fixed-point precision are skipped by the scatter pass too
+            R2DFixedBox fixed_box = r2d_fixed_box(box);
+            if (fixed_box.x0 >= fixed_box.x1 || fixed_box.y0 >= fixed_box.y1) {
+                boxes[i] = R2DFixedBox{};
+                continue;
+            }
+            boxes[i] = fixed_box;
+            int32_t band0 = fixed_box.y0 >> (8 + band_shift);
+            int32_t band1 = (((fixed_box.y1 + 255) >> 8) - 1) >> band_shift;
+            for (int32_t band = band0; band <= band1; band++) {
+                band_offsets[band + 1]++;
+            }
+            num_items += band1 - band0 + 1;
+        }
+
+        if (num_items == 0)
+            return;
+
+        for (uint32_t band = 0; band < num_bands; band++) {
+            band_offsets[band + 1] += band_offsets[band];
+        }
+
+        // Scatter the rectangle indices into their bands
+        band_items.resize(num_items);
+        for (size_t i = 0; i < count; i++) {
+            const R2DFixedBox& fixed_box = boxes[i];
+            if (fixed_box.x0 >= fixed_box.x1 || fixed_box.y0 >= fixed_box.y1)
+                continue;
+            int32_t band0 = fixed_box.y0 >> (8 + band_shift);
+            int32_t band1 = (((fixed_box.y1 + 255) >> 8) - 1) >> band_shift;
+            for (int32_t band = band0; band <= band1; band++) {
+                band_items[band_offsets[band]++] = (uint32_t)i;
+            }
+        }
+
+        // After scattering band_offsets[band] points to the end of the band
+        uint32_t item_begin = 0;
+        for (uint32_t band = 0; band < num_bands; band++) {
+            int32_t band_y0 = band << band_shift;
+            int32_t band_y1 = band_y0 + (1 << band_shift);
+            uint32_t item_end = band_offsets[band];
+            for (uint32_t item = item_begin; item < item_end; item++) {
+                uint32_t index = band_items[item];
+                const R2DFixedBox& fixed_box = boxes[index];
+                int32_t y0 = r2d_max(fixed_box.y0 >> 8, band_y0);
+                int32_t y1 = r2d_min((fixed_box.y1 + 255) >> 8, band_y1);
+                R2DColor8 src = colors ? colors[index] : source_->solid;
+                blend_rect_rows(blend_fn, fixed_box, y0, y1, src);
+            }
+            item_begin = item_end;
+        }
+    }
+
+    // Blend the [y0, y1) rows of a clipped rectangle
+    template <typename BlendFnT>
+    R2D_FORCEINLINE void blend_rect_rows(BlendFnT& blend_fn, const R2DFixedBox& box, int32_t y0,
+                                         int32_t y1, R2DColor8 src) noexcept {
+        uint32_t src_color = 0xFFFFFF & src;
+        uint32_t src_alpha = (0xFF000000 & src) >> 24;
+        int32_t ix0 = box.x0 >> 8;
+        int32_t ix1 = (box.x1 + 255) >> 8;
+
+        for (int32_t y = y0; y < y1; y++) {
+            int32_t cover_y = r2d_min((y + 1) << 8, box.y1) - r2d_max(y << 8, box.y0);
+            blend_rect_row(blend_fn, rt_->row<R2DPixel>(y), ix0, ix1, box.x0, box.x1, cover_y,
+                           src_color, src_alpha);
+        }
+    }
+
+    // Blend one row of a rectangle spanning [x0, x1) pixels. Only the first and the last pixel
+    // can be partially covered horizontally.
+    template <typename BlendFnT>
+    R2D_FORCEINLINE void blend_rect_row(BlendFnT& blend_fn, R2DPixel* row, int32_t x0, int32_t x1,
+                                        R2DFixed32 fx0, R2DFixed32 fx1, int32_t cover_y,
+                                        R2DColor8 src_color, uint32_t src_alpha) noexcept {
+        if (x1 - x0 == 1) {
+            uint32_t coverage = r2d_area_coverage(fx0 - x0 * 256, fx1 - x0 * 256, cover_y);
+            row[x0] = blend_pixel(blend_fn, row[x0], src_color, src_alpha, coverage);
+            return;
+        }
+        uint32_t coverage0 = r2d_area_coverage(fx0 - x0 * 256, 256, cover_y);
+        uint32_t coverage1 = r2d_area_coverage(0, fx1 - (x1 - 1) * 256, cover_y);
+        row[x0] = blend_pixel(blend_fn, row[x0], src_color, src_alpha, coverage0);
+        blend_span(blend_fn, row, x0 + 1, x1 - 1, src_color, src_alpha,
+                   r2d_area_coverage(0, 256, cover_y));
+        row[x1 - 1] = blend_pixel(blend_fn, row[x1 - 1], src_color, src_alpha, coverage1);
+    }
+
+    // Fill a rounded rectangle. Rows outside of the corners are filled like a plain rectangle, the
+    // corner coverage is only evaluated for pixels inside the four corner boxes.
+    template <typename BlendFnT>
+    void render_rounded_rect_solid(const R2DBox& rect, float radius, R2DColor8 src) noexcept {
+        assert(rt_ && "Render target is not specified");
+        R2DBox box = rect;
+        if (!clip_to_target(box))
+            return;
+
+        BlendFnT blend_fn{};
+        uint32_t src_color = 0xFFFFFF & src;
+        uint32_t src_alpha = (0xFF000000 & src) >> 24;
+
+        R2DFixed32 fx0 = r2d_iround(box.x0 * 256.0f);
+        R2DFixed32 fy0 = r2d_iround(box.y0 * 256.0f);
+        R2DFixed32 fx1 = r2d_iround(box.x1 * 256.0f);
+        R2DFixed32 fy1 = r2d_iround(box.y1 * 256.0f);
+        int32_t ix0 = fx0 >> 8;
+        int32_t iy0 = fy0 >> 8;
+        int32_t ix1 = (fx1 + 255) >> 8;
+        int32_t iy1 = (fy1 + 255) >> 8;
+
+        // Center of the corner arcs
+        float cx0 = rect.x0 + radius;
+        float cy0 = rect.y0 + radius;
+        float cx1 = rect.x1 - radius;
+        float cy1 = rect.y1 - radius;
+
+        // Pixels in [corner_x0, corner_x1) columns and [corner_y0, corner_y1) rows are never
+        // touched by the arcs or the partially covered left and right edges
+        int32_t corner_x0 = r2d_max((int32_t)std::ceil(cx0), (fx0 + 255) >> 8);
+        int32_t corner_x1 = r2d_min((int32_t)std::floor(cx1), fx1 >> 8);
+        corner_x0 = r2d_clamp(corner_x0, ix0, ix1);
+        corner_x1 = r2d_clamp(corner_x1, corner_x0, ix1);
+        int32_t corner_y0 = (int32_t)std::ceil(cy0);
+        int32_t corner_y1 = (int32_t)std::floor(cy1);
+
+        for (int32_t y = iy0; y < iy1; y++) {
+            R2DPixel* row = rt_->row<R2DPixel>(y);
+            int32_t cover_y = r2d_min((y + 1) << 8, fy1) - r2d_max(y << 8, fy0);
+
+            if (y >= corner_y0 && y < corner_y1) {
+                blend_rect_row(blend_fn, row, ix0, ix1, fx0, fx1, cover_y, src_color, src_alpha);
+                continue;
+            }
+
+            float py = (float)y + 0.5f;
+            float dy = r2d_max(cy0 - py, py - cy1);
+
+            for (int32_t x = ix0; x < corner_x0; x++) {
+                uint32_t coverage =
+                    rounded_corner_coverage(x, dy, cx0, cx1, radius, fx0, fx1, cover_y);
+                row[x] = blend_pixel(blend_fn, row[x], src_color, src_alpha, coverage);
+            }
+
+            blend_span(blend_fn, row, corner_x0, corner_x1, src_color, src_alpha,
+                       r2d_area_coverage(0, 256, cover_y));
+
+            for (int32_t x = corner_x1; x < ix1; x++) {
+                uint32_t coverage =
+                    rounded_corner_coverage(x, dy, cx0, cx1, radius, fx0, fx1, cover_y);
+                row[x] = blend_pixel(blend_fn, row[x], src_color, src_alpha, coverage);
+            }
+        }
+    }
+
+    // Coverage of a pixel inside a corner box. The arc coverage is approximated from the distance
+    // between the pixel center and the arc, pixels beside the arc use the straight edge coverage.
+    R2D_FORCEINLINE static uint32_t rounded_corner_coverage(int32_t x, float dy, float cx0,
+                                                            float cx1, float radius,
+                                                            R2DFixed32 fx0, R2DFixed32 fx1,
+                                                            int32_t cover_y) noexcept {
+        int32_t cover_x0 = r2d_max(x << 8, fx0) - (x << 8);
+        int32_t cover_x1 = r2d_min((x + 1) << 8, fx1) - (x << 8);
+        uint32_t coverage = r2d_area_coverage(cover_x0, cover_x1, cover_y);
+        float px = (float)x + 0.5f;
+        float dx = r2d_max(cx0 - px, px - cx1);
+        if (dx <= 0.0f || dy <= 0.0f)
+            return coverage;
+        float dist = radius + 0.5f - r2d_sqrt(dx * dx + dy * dy);
+        uint32_t arc_coverage = (uint32_t)r2d_iround(r2d_clamp(dist, 0.0f, 1.0f) * 255.0f);
+        return r2d_min(arc_coverage, coverage);
+    }
+
     void draw_rect() noexcept {}
 
+    // Transform a box into device space. Returns false if the transformation does not keep the
+    // box axis-aligned.
+    R2D_FORCEINLINE bool transform_box(R2DBox& box) const noexcept {
+        if (transform_.is_identity())
+            return true;
+        if (!transform_.is_axis_aligned())
+            return false;
+        R2DPoint p0 = transform_point(R2DPoint{box.x0, box.y0});
+        R2DPoint p1 = transform_point(R2DPoint{box.x1, box.y1});
+        box = R2DBox{r2d_min(p0.x, p1.x), r2d_min(p0.y, p1.y), r2d_max(p0.x, p1.x),
+                     r2d_max(p0.y, p1.y)};
+        return true;
+    }
+
+    void add_rect(float x, float y, float w, float h) {
+        const R2DPoint verts[4] = {{x, y}, {x + w, y}, {x + w, y + h}, {x, y + h}};
+        add_polygon(verts, 4);
+    }
+
+    // Add a rounded rectangle as a polygon with flattened corner arcs. Used when the rounded
+    // rectangle cannot be filled analytically.
+    void add_rounded_rect(float x, float y, float w, float h, float radius) {
+        radius = r2d_clamp(radius, 0.0f, r2d_min(w, h) * 0.5f);
+        if (radius <= 0.0f) {
+            add_rect(x, y, w, h);
+            return;
+        }
+
+        // Pick the number of segments per corner from the radius in device space
+        float device_radius = radius * r2d_sqrt(std::fabs(transform_.determinant()));
+        int num_segments = r2d_clamp((int)(r2d_sqrt(device_radius) * 2.0f) + 2, 2, 64);
+        float step = 1.57079632679f / (float)num_segments;
+
+        static constexpr float corner_angle[4] = {3.14159265359f, 4.71238898038f, 0.0f,
+                                                  1.57079632679f};
+        float corner_x[4] = {x + radius, x + w - radius, x + w - radius, x + radius};
+        float corner_y[4] = {y + radius, y + radius, y + h - radius, y + h - radius};
+
+        R2DVector<R2DPoint>& points = tmp_shape_points_;
+        points.clear();
+        for (int corner = 0; corner < 4; corner++) {
+            for (int i = 0; i <= num_segments; i++) {
+                float angle = corner_angle[corner] + step * (float)i;
+                points.push_back(R2DPoint{corner_x[corner] + std::cos(angle) * radius,
+                                          corner_y[corner] + std::sin(angle) * radius});
+            }
+        }
+        add_polygon(points.data(), points.size());
+    }
+
     void draw_rect_filled(float x, float y, float w, float h) noexcept {
-        float x1 = x + w;
-        float y1 = y + h;
-        plot_move_to(x, y);
-        plot_line_to(x1, y);
-        plot_line_to(x1, y1);
-        plot_line_to(x, y1);
-        plot_line_to(x, y);
-        plot_end();
+        assert(source_ && "Source color is not specified");
+        R2DBox box{x, y, x + w, y + h};
+        if (source_->type != R2DSourceType::Solid ||
+            !has_rect_fast_path() || !transform_box(box)) {
+            add_rect(x, y, w, h);
+            render_raster();
+            discard_raster();
+            return;
+        }
+        dispatch_blend_mode([&](auto blend_fn) {
+            render_rect_solid<decltype(blend_fn)>(box, source_->solid);
+        });
+    }
+
+    // Fill `count` rectangles in one pass. `colors` holds one RGBA8 color per rectangle, if it is
+    // null the current source color is used for all of them.
+    void draw_rects_filled(const R2DRect* rects, const R2DColor8* colors, size_t count) {
+        assert((colors || source_) && "Source color is not specified");
+        if (count == 0)
+            return;
+
+        if (!transform_.is_axis_aligned() || !has_rect_fast_path() ||
+            (!colors && source_->type != R2DSourceType::Solid)) {
+            // Rotated or non-solid rectangles have to go through the raster one by one
+            const R2DSource* source = source_;
+            R2DSource rect_source{};
+            rect_source.type = R2DSourceType::Solid;
+            for (size_t i = 0; i < count; i++) {
+                if (colors) {
+                    rect_source.solid = colors[i];
+                    source_ = &rect_source;
+                }
+                add_rect(rects[i].x, rects[i].y, rects[i].w, rects[i].h);
+                render_raster();
+                discard_raster();
+            }
+            source_ = source;
+            return;
+        }
+
+        dispatch_blend_mode([&](auto blend_fn) {
+            render_rects_solid<decltype(blend_fn)>(rects, colors, count);
+        });
+    }
+
+    void draw_rounded_rect_filled(float x, float y, float w, float h, float radius) noexcept {
+        assert(source_ && "Source color is not specified");
+        R2DBox box{x, y, x + w, y + h};
+        radius = r2d_clamp(radius, 0.0f, r2d_min(w, h) * 0.5f);
+
+        // The analytic path needs circular corners in device space
+        float scale_x = std::fabs(transform_.m[0]);
+        float scale_y = std::fabs(transform_.m[4]);
+        if (source_->type != R2DSourceType::Solid ||
+            !has_rect_fast_path() || !transform_box(box) ||
+            scale_x != scale_y) {
+            add_rounded_rect(x, y, w, h, radius);
+            render_raster();
+            discard_raster();
+            return;
+        }
+
+        radius *= scale_x;
+        dispatch_blend_mode([&](auto blend_fn) {
+            if (radius > 0.0f)
+                render_rounded_rect_solid<decltype(blend_fn)>(box, radius, source_->solid);
+            else
+                render_rect_solid<decltype(blend_fn)>(box, source_->solid);
+        });
+    }
+
+    void draw_triangle_filled(const R2DPoint& v0, const R2DPoint& v1, const R2DPoint& v2) noexcept {
+        const R2DPoint verts[3] = {v0, v1, v2};
+        add_polygon(verts, 3);
         render_raster();
         discard_raster();
     }
 
-    void draw_triangle_filled(const R2DPoint& v0, const R2DPoint& v1, const R2DPoint& v2) noexcept {
+    // Fill an indexed triangle list. `colors` holds one RGBA8 color per vertex which is
+    // interpolated across each triangle, if it is null the current source is used instead. All
+    // triangles go into the same raster so shared edges do not leave seams.
+    void draw_triangles(const R2DPoint* verts, const R2DColor8* colors, size_t vertex_count,
+                        const uint32_t* indices, size_t index_count) {
+        assert((colors || source_) && "Source color is not specified");
+        if (index_count < 3)
+            return;
+
+        const R2DPoint* points = transform_vertices(verts, vertex_count);
+        size_t num_triangles = index_count / 3;
+        for (size_t i = 0; i < num_triangles; i++) {
+            const uint32_t* tri = indices + i * 3;
+            add_triangle(points[tri[0]], points[tri[1]], points[tri[2]]);
+        }
+
+        if (!colors) {
+            render_raster();
+            discard_raster();
+            return;
+        }
+
+        // The color buffer covers the same area as render_raster_fetch
+        int32_t x0 = raster_->min_x_;
+        int32_t y0 = raster_->min_y_;
+        int32_t x1 = r2d_min(raster_->max_x_ + 1, (int32_t)r2d_min(rt_->width_, raster_->width_));
+        int32_t y1 = r2d_min(raster_->max_y_ + 1, (int32_t)r2d_min(rt_->height_, raster_->height_));
+        if (x0 >= x1 || y0 >= y1) {
+            discard_raster();
+            return;
+        }
+
+        size_t stride = (size_t)(x1 - x0);
+        tmp_mesh_colors_.resize(stride * (size_t)(y1 - y0));
+        R2DColor8* buffer = tmp_mesh_colors_.data();
+        for (size_t i = 0; i < num_triangles; i++) {
+            const uint32_t* tri = indices + i * 3;
+            shade_triangle(buffer, stride, x0, y0, x1, y1, points, colors, tri);
+        }
+
+        R2DFetchBuffer fetcher{buffer, stride, x0, y0};
+        render_raster_source(fetcher);
+        discard_raster();
+    }
+
+    // Add a device space triangle to the raster. Triangles are always added in the same winding
+    // so that the coverage of two triangles sharing an edge cancels out exactly along that edge.
+    void add_triangle(const R2DPoint& v0, const R2DPoint& v1, const R2DPoint& v2) {
+        float area = (v1.x - v0.x) * (v2.y - v0.y) - (v2.x - v0.x) * (v1.y - v0.y);
+        if (area == 0.0f)
+            return;
+        const R2DPoint& a = area > 0.0f ? v1 : v2;
+        const R2DPoint& b = area > 0.0f ? v2 : v1;
         plot_move_to(v0.x, v0.y);
-        plot_line_to(v1.x, v1.y);
-        plot_line_to(v2.x, v2.y);
+        plot_line_to(a.x, a.y);
+        plot_line_to(b.x, b.y);
         plot_line_to(v0.x, v0.y);
         plot_end();
-        render_raster();
-        discard_raster();
+    }
+
+    // Write the interpolated vertex colors of a triangle into the color buffer. Every pixel that
+    // is touched by the triangle gets a color, partially covered edge pixels included. The colors
+    // are evaluated at the pixel centers and stepped incrementally along each span.
+    static void shade_triangle(R2DColor8* buffer, size_t stride, int32_t x0, int32_t y0,
+                               int32_t x1, int32_t y1, const R2DPoint* points,
+                               const R2DColor8* colors, const uint32_t* tri) noexcept {
+        R2DPoint a = points[tri[0]];
+        R2DPoint b = points[tri[1]];
+        R2DPoint c = points[tri[2]];
+        float det = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+        if (det == 0.0f)
+            return;
+
+        // Color gradients of the triangle plane, all four channels at once
+        __m128i zero = _mm_setzero_si128();
+        auto unpack = [zero](R2DColor8 color) {
+            __m128i v = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)color), zero);
+            return _mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero));
+        };
+        __m128 col_a = unpack(colors[tri[0]]);
+        __m128 col_ab = _mm_sub_ps(unpack(colors[tri[1]]), col_a);
+        __m128 col_ac = _mm_sub_ps(unpack(colors[tri[2]]), col_a);
+        __m128 inv_det = _mm_set1_ps(1.0f / det);
+        __m128 dcdx = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(col_ab, _mm_set1_ps(c.y - a.y)),
+                                            _mm_mul_ps(col_ac, _mm_set1_ps(b.y - a.y))),
+                                 inv_det);
+        __m128 dcdy = _mm_mul_ps(_mm_sub_ps(_mm_mul_ps(col_ac, _mm_set1_ps(b.x - a.x)),
+                                            _mm_mul_ps(col_ab, _mm_set1_ps(c.x - a.x))),
+                                 inv_det);
+
+        // Edges sorted by y: (v[0], v[1]), (v[1], v[2]) and the long edge (v[0], v[2])
+        R2DPoint v[3] = {a, b, c};
+        if (v[1].y < v[0].y)
+            std::swap(v[0], v[1]);
+        if (v[2].y < v[1].y)
+            std::swap(v[1], v[2]);
+        if (v[1].y < v[0].y)
+            std::swap(v[0], v[1]);
+
+        static constexpr int edges[3][2] = {{0, 1}, {1, 2}, {0, 2}};
+        float slopes[3];
+        for (int e = 0; e < 3; e++) {
+            const R2DPoint& p = v[edges[e][0]];
+            const R2DPoint& q = v[edges[e][1]];
+            slopes[e] = q.y > p.y ? (q.x - p.x) / (q.y - p.y) : 0.0f;
+        }
+
+        int32_t row_begin = r2d_max((int32_t)std::floor(v[0].y), y0);
+        int32_t row_end = r2d_min((int32_t)std::ceil(v[2].y), y1);
+        for (int32_t y = row_begin; y < row_end; y++) {
+            // Horizontal extent of the triangle within this pixel row
+            float band_y0 = r2d_max((float)y, v[0].y);
+            float band_y1 = r2d_min((float)(y + 1), v[2].y);
+            float span_x0 = std::numeric_limits<float>::max();
+            float span_x1 = -std::numeric_limits<float>::max();
+            for (int e = 0; e < 3; e++) {
+                const R2DPoint& p = v[edges[e][0]];
+                const R2DPoint& q = v[edges[e][1]];
+                float ey0 = r2d_max(band_y0, p.y);
+                float ey1 = r2d_min(band_y1, q.y);
+                if (ey0 > ey1)
+                    continue;
+                float ex0 = p.x + (ey0 - p.y) * slopes[e];
+                float ex1 = q.y > p.y ? p.x + (ey1 - p.y) * slopes[e] : q.x;
+                span_x0 = r2d_min(span_x0, r2d_min(ex0, ex1));
+                span_x1 = r2d_max(span_x1, r2d_max(ex0, ex1));
+            }
+
+            int32_t span_begin = r2d_max((int32_t)std::floor(span_x0), x0);
+            int32_t span_end = r2d_min((int32_t)std::ceil(span_x1), x1);
+            if (span_begin >= span_end)
+                continue;
+
+            __m128 col = _mm_add_ps(
+                col_a, _mm_add_ps(_mm_mul_ps(dcdx, _mm_set1_ps((float)span_begin + 0.5f - a.x)),
+                                  _mm_mul_ps(dcdy, _mm_set1_ps((float)y + 0.5f - a.y))));
+            R2DColor8* row = buffer + (size_t)(y - y0) * stride - x0;
+            for (int32_t x = span_begin; x < span_end; x++) {
+                // Extrapolated colors of the edge pixels are clamped by the saturating packs
+                __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(col), zero);
+                row[x] = (R2DColor8)_mm_cvtsi128_si32(_mm_packus_epi16(packed, zero));
+                col = _mm_add_ps(col, dcdx);
+            }
+        }
     }
 
     void draw_circle(float cx, float cy, float radius) noexcept {}
 
     inline void draw_line(const R2DPoint& v0, const R2DPoint& v1) noexcept {
-        add_line(v0, v1);
+        if (is_dashed()) {
+            const R2DPoint verts[2] = {transform_point(v0), transform_point(v1)};
+            add_dashed_polyline(verts, 2, false);
+        } else {
+            add_line(v0, v1);
+        }
         render_raster();
         discard_raster();
     }
@@ -2,9 +2,11 @@
 
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <emmintrin.h>
 #include <limits>
 #include <memory>
+#include <thread>
 #include <xmmintrin.h>
 
 #ifdef NDEBUG
@@ -48,12 +50,20 @@ struct R2DBox {
     float y1;
 };
 
+struct R2DFixedBox {
+    R2DFixed32 x0;
+    R2DFixed32 y0;
+    R2DFixed32 x1;
+    R2DFixed32 y1;
+};
+
 struct R2DIntersection {
     float x;
     float y;
     uint32_t flag;
 };
 
+// Minimal growable array. Only meant for trivially copyable types.
 template <typename T>
 struct R2DVector {
     T* data_{};
@@ -62,14 +72,44 @@ struct R2DVector {
 
     inline R2DVector() {}
 
+    R2DVector(const R2DVector&) = delete;
+
     inline ~R2DVector() {
         if (data_)
             std::free(data_);
     }
 
-    inline void resize(size_t capacity) {}
+    inline void resize(size_t size) {
+        reserve(size);
+        size_ = size;
+    }
+
+    inline void reserve(size_t capacity) {
+        if (capacity <= capacity_)
+            return;
+        T* new_data = (T*)std::realloc(data_, capacity * sizeof(T));
+        if (!new_data)
+            std::abort();
+        data_ = new_data;
+        capacity_ = capacity;
+    }
+
+    R2D_FORCEINLINE void push_back(const T& value) {
+        if (size_ == capacity_)
+            reserve(capacity_ ? capacity_ * 2 : 16);
+        data_[size_++] = value;
+    }
 
-    inline void reserve(size_t capacity) {}
+    R2D_FORCEINLINE void pop_back() noexcept { size_--; }
+
+    R2D_FORCEINLINE void clear() noexcept { size_ = 0; }
+
+    R2D_FORCEINLINE T& operator[](size_t index) noexcept { return data_[index]; }
+    R2D_FORCEINLINE const T& operator[](size_t index) const noexcept { return data_[index]; }
+    R2D_FORCEINLINE T& back() noexcept { return data_[size_ - 1]; }
+    R2D_FORCEINLINE T* data() const noexcept { return data_; }
+    R2D_FORCEINLINE size_t size() const noexcept { return size_; }
+    R2D_FORCEINLINE bool empty() const noexcept { return size_ == 0; }
 };
 
 template <typename T>
@@ -111,38 +151,284 @@ static float r2d_sqrt(float x) {
     return _mm_cvtss_f32(_mm_sqrt_ss(ss));
 }
 
+// Select `a` where `mask` is set, otherwise `b`
 R2D_FORCEINLINE
-static void r2d_clear_image(R2DColor8* data, uint32_t width, uint32_t height, R2DColor8 color) {
-#if 1
-    for (uint32_t i = 0; i < width * height; i++) {
-        data[i] = color;
+static __m128 r2d_select_ps(__m128 mask, __m128 a, __m128 b) {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// floor() for values in the int32 range
+R2D_FORCEINLINE
+static __m128 r2d_floor_ps(__m128 x) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+// Vectorized atan2 approximation, the maximum error is around 2e-6 radians
+R2D_FORCEINLINE
+static __m128 r2d_atan2_ps(__m128 y, __m128 x) {
+    const __m128 sign_mask = _mm_set1_ps(-0.0f);
+    __m128 abs_x = _mm_andnot_ps(sign_mask, x);
+    __m128 abs_y = _mm_andnot_ps(sign_mask, y);
+    __m128 max_xy = _mm_max_ps(abs_x, abs_y);
+    __m128 min_xy = _mm_min_ps(abs_x, abs_y);
+    __m128 z = _mm_div_ps(min_xy, _mm_max_ps(max_xy, _mm_set1_ps(1e-30f)));
+    __m128 z2 = _mm_mul_ps(z, z);
+
+    // Minimax polynomial of atan(z) in [0, 1]
+    __m128 r = _mm_set1_ps(-0.01172120f);
+    r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(0.05265332f));
+    r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(-0.11643287f));
+    r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(0.19354346f));
+    r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(-0.33262347f));
+    r = _mm_add_ps(_mm_mul_ps(r, z2), _mm_set1_ps(0.99997726f));
+    r = _mm_mul_ps(r, z);
+
+    // Map back into the full circle
+    r = r2d_select_ps(_mm_cmpgt_ps(abs_y, abs_x), _mm_sub_ps(_mm_set1_ps(1.57079632679f), r), r);
+    r = r2d_select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(3.14159265359f), r),
+                      r);
+    return _mm_or_ps(r, _mm_and_ps(sign_mask, y));
+}
+
+// Fills of at least this many bytes use non-temporal stores, they would only evict the cache
+#ifndef R2D_STREAMING_STORE_THRESHOLD
+#define R2D_STREAMING_STORE_THRESHOLD (4u << 20)
+#endif
+
+// Threaded fills give each thread at least this many bytes
+#ifndef R2D_THREADED_FILL_MIN_SIZE
+#define R2D_THREADED_FILL_MIN_SIZE (1u << 20)
+#endif
+
+// Fill `size` bytes with a 16-byte pattern that starts at `dst`. `dst` can have any alignment,
+// the bulk is written with aligned stores of 64 bytes. Non-temporal stores are not fenced.
+static void r2d_fill_bytes(uint8_t* dst, size_t size, __m128i pattern, bool streaming) noexcept {
+    alignas(16) uint8_t bytes[32];
+    _mm_store_si128((__m128i*)bytes, pattern);
+    _mm_store_si128((__m128i*)(bytes + 16), pattern);
+    size_t head = r2d_min((size_t)(16 - ((uintptr_t)dst & 15)) & 15, size);
+    std::memcpy(dst, bytes, head);
+
+    // The aligned part starts `head` bytes into the pattern
+    __m128i value = _mm_loadu_si128((const __m128i*)(bytes + head));
+    size_t i = head;
+    if (streaming) {
+        for (; i + 64 <= size; i += 64) {
+            _mm_stream_si128((__m128i*)(dst + i), value);
+            _mm_stream_si128((__m128i*)(dst + i + 16), value);
+            _mm_stream_si128((__m128i*)(dst + i + 32), value);
+            _mm_stream_si128((__m128i*)(dst + i + 48), value);
+        }
+        for (; i + 16 <= size; i += 16)
+            _mm_stream_si128((__m128i*)(dst + i), value);
+    } else {
+        for (; i + 64 <= size; i += 64) {
+            _mm_store_si128((__m128i*)(dst + i), value);
+            _mm_store_si128((__m128i*)(dst + i + 16), value);
+            _mm_store_si128((__m128i*)(dst + i + 32), value);
+            _mm_store_si128((__m128i*)(dst + i + 48), value);
+        }
+        for (; i + 16 <= size; i += 16)
+            _mm_store_si128((__m128i*)(dst + i), value);
     }
-#else
-    uint32_t num_pixels = width * height;
-    uint32_t rem = num_pixels % 16;
-    uint32_t count = num_pixels - rem;
-    __m128i col = _mm_set1_epi32(color);
-    for (uint32_t i = 0; i < count; i += 16) {
-        _mm_storeu_si128((__m128i*)(data + i), col);
-        _mm_storeu_si128((__m128i*)(data + i + 4), col);
-        _mm_storeu_si128((__m128i*)(data + i + 8), col);
-        _mm_storeu_si128((__m128i*)(data + i + 12), col);
+    std::memcpy(dst + i, bytes + head, size - i);
+}
+
+// Fill `height` rows of `row_size` bytes, `stride` bytes apart. `pattern` holds the pixel value
+// repeated over 16 bytes, so the pixel size has to divide 16. The rows are split into bands over
+// up to `thread_count` threads for large fills.
+static void r2d_fill_pixels(uint8_t* dst, size_t stride, size_t row_size, uint32_t height,
+                            __m128i pattern, uint32_t thread_count = 1) {
+    size_t total_size = row_size * height;
+    bool streaming = total_size >= R2D_STREAMING_STORE_THRESHOLD;
+    auto fill_rows = [=](uint32_t y0, uint32_t y1) {
+        if (stride == row_size) {
+            r2d_fill_bytes(dst + y0 * stride, (y1 - y0) * row_size, pattern, streaming);
+        } else {
+            for (uint32_t y = y0; y < y1; y++)
+                r2d_fill_bytes(dst + y * stride, row_size, pattern, streaming);
+        }
+        if (streaming)
+            _mm_sfence();
+    };
+
+    size_t max_threads = r2d_max(total_size / R2D_THREADED_FILL_MIN_SIZE, (size_t)1);
+    thread_count = (uint32_t)r2d_min(r2d_min((size_t)thread_count, max_threads), (size_t)height);
+    if (thread_count <= 1) {
+        fill_rows(0, height);
+        return;
     }
 
-    for (uint32_t i = count; i < num_pixels; i++) {
-        data[i] = color;
+    std::unique_ptr<std::thread[]> threads(new std::thread[thread_count - 1]);
+    for (uint32_t i = 1; i < thread_count; i++) {
+        uint32_t y0 = (uint32_t)((uint64_t)height * i / thread_count);
+        uint32_t y1 = (uint32_t)((uint64_t)height * (i + 1) / thread_count);
+        threads[i - 1] = std::thread(fill_rows, y0, y1);
     }
-#endif
+    fill_rows(0, height / thread_count);
+    for (uint32_t i = 0; i < thread_count - 1; i++)
+        threads[i].join();
+}
+
+static void r2d_clear_image(R2DColor8* data, uint32_t width, uint32_t height, R2DColor8 color,
+                            uint32_t thread_count = 1) {
+    size_t row_size = (size_t)width * sizeof(R2DColor8);
+    r2d_fill_pixels((uint8_t*)data, row_size, row_size, height, _mm_set1_epi32((int)color),
+                    thread_count);
+}
+
+// Copy `size` bytes, the ranges may overlap unless `streaming` is set. Streaming copies write
+// the bulk with non-temporal stores, which are not fenced.
+static void r2d_copy_bytes(uint8_t* dst, const uint8_t* src, size_t size, bool streaming) noexcept {
+    if (!streaming) {
+        std::memmove(dst, src, size);
+        return;
+    }
+    size_t head = r2d_min((size_t)(16 - ((uintptr_t)dst & 15)) & 15, size);
+    std::memcpy(dst, src, head);
+    size_t i = head;
+    for (; i + 64 <= size; i += 64) {
+        __m128i v0 = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i v1 = _mm_loadu_si128((const __m128i*)(src + i + 16));
+        __m128i v2 = _mm_loadu_si128((const __m128i*)(src + i + 32));
+        __m128i v3 = _mm_loadu_si128((const __m128i*)(src + i + 48));
+        _mm_stream_si128((__m128i*)(dst + i), v0);
+        _mm_stream_si128((__m128i*)(dst + i + 16), v1);
+        _mm_stream_si128((__m128i*)(dst + i + 32), v2);
+        _mm_stream_si128((__m128i*)(dst + i + 48), v3);
+    }
+    for (; i + 16 <= size; i += 16)
+        _mm_stream_si128((__m128i*)(dst + i), _mm_loadu_si128((const __m128i*)(src + i)));
+    std::memcpy(dst + i, src + i, size - i);
+}
+
+// Copy `height` rows of `row_size` bytes between two strided regions. Overlapping regions of
+// the same image are copied in the order that reads every row before it is overwritten, large
+// disjoint copies bypass the cache.
+static void r2d_copy_rows(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride,
+                          size_t row_size, uint32_t height) noexcept {
+    if (row_size == 0 || height == 0)
+        return;
+    uintptr_t dst_begin = (uintptr_t)dst;
+    uintptr_t src_begin = (uintptr_t)src;
+    uintptr_t dst_end = dst_begin + (height - 1) * dst_stride + row_size;
+    uintptr_t src_end = src_begin + (height - 1) * src_stride + row_size;
+    bool overlap = dst_begin < src_end && src_begin < dst_end;
+
+    if (overlap && dst_begin > src_begin) {
+        // Moving towards the end, e.g. scrolling down
+        for (uint32_t y = height; y-- > 0;)
+            std::memmove(dst + y * dst_stride, src + y * src_stride, row_size);
+        return;
+    }
+
+    bool streaming = !overlap && row_size * height >= R2D_STREAMING_STORE_THRESHOLD;
+    for (uint32_t y = 0; y < height; y++)
+        r2d_copy_bytes(dst + y * dst_stride, src + y * src_stride, row_size, streaming);
+    if (streaming)
+        _mm_sfence();
 }
 
 R2D_FORCEINLINE
 static void r2d_copy_image(R2DColor8* dst_image, uint32_t dst_stride, uint32_t dst_x,
-                           uint32_t dst_y, R2DColor8* src_image, uint32_t src_stride,
+                           uint32_t dst_y, const R2DColor8* src_image, uint32_t src_stride,
                            uint32_t src_x, uint32_t src_y, uint32_t width, uint32_t height) {
-    for (uint32_t i = 0; i < height; i++) {
-        uint32_t dst_pos = dst_stride * (i + dst_y) + dst_x;
-        uint32_t src_pos = src_stride * (i + src_y) + src_x;
-        std::memcpy(dst_image + dst_pos, src_image + src_pos, width * sizeof(R2DColor8));
+    r2d_copy_rows((uint8_t*)(dst_image + (size_t)dst_stride * dst_y + dst_x),
+                  (size_t)dst_stride * sizeof(R2DColor8),
+                  (const uint8_t*)(src_image + (size_t)src_stride * src_y + src_x),
+                  (size_t)src_stride * sizeof(R2DColor8), (size_t)width * sizeof(R2DColor8),
+                  height);
+}
+
+// Move the color channels from one channel layout into another
+R2D_FORCEINLINE
+static R2DColor8 r2d_swizzle_color(R2DColor8 color, const R2DColorBitShift& from,
+                                   const R2DColorBitShift& to) noexcept {
+    uint32_t r = (color >> from.r) & 0xFF;
+    uint32_t g = (color >> from.g) & 0xFF;
+    uint32_t b = (color >> from.b) & 0xFF;
+    uint32_t a = (color >> from.a) & 0xFF;
+    return (r << to.r) | (g << to.g) | (b << to.b) | (a << to.a);
+}
+
+// Move the color channels of a row of pixels from one channel layout into another, 4 pixels per
+// iteration. `alpha_fill` is ORed into the result, e.g. to set the unused byte of an opaque
+// layout to 255.
+static void r2d_swizzle_row(R2DColor8* dst, const R2DColor8* src, size_t count,
+                            const R2DColorBitShift& from, const R2DColorBitShift& to,
+                            R2DColor8 alpha_fill = 0) noexcept {
+    size_t i = 0;
+    if (from.r == to.r && from.g == to.g && from.b == to.b && from.a == to.a) {
+        __m128i fill = _mm_set1_epi32((int)alpha_fill);
+        for (; i + 4 <= count; i += 4) {
+            __m128i px = _mm_loadu_si128((const __m128i*)(src + i));
+            _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(px, fill));
+        }
+        for (; i < count; i++)
+            dst[i] = src[i] | alpha_fill;
+        return;
+    }
+
+    __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i fill = _mm_set1_epi32((int)alpha_fill);
+    __m128i shift_in[4] = {_mm_cvtsi32_si128((int)from.r), _mm_cvtsi32_si128((int)from.g),
+                           _mm_cvtsi32_si128((int)from.b), _mm_cvtsi32_si128((int)from.a)};
+    __m128i shift_out[4] = {_mm_cvtsi32_si128((int)to.r), _mm_cvtsi32_si128((int)to.g),
+                            _mm_cvtsi32_si128((int)to.b), _mm_cvtsi32_si128((int)to.a)};
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i result = fill;
+        for (int c = 0; c < 4; c++) {
+            __m128i channel = _mm_and_si128(_mm_srl_epi32(px, shift_in[c]), mask);
+            result = _mm_or_si128(result, _mm_sll_epi32(channel, shift_out[c]));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), result);
+    }
+    for (; i < count; i++)
+        dst[i] = r2d_swizzle_color(src[i], from, to) | alpha_fill;
+}
+
+// Magnify an image by an integer factor by replicating every source pixel into a `scale` x
+// `scale` block. Only the first destination row of each source row is generated, the remaining
+// `scale - 1` rows are copies of it. `dst_width` and `dst_height` clip the destination.
+R2D_FORCEINLINE
+static void r2d_scale_image_nearest(R2DColor8* dst_image, uint32_t dst_stride, uint32_t dst_width,
+                                    uint32_t dst_height, const R2DColor8* src_image,
+                                    uint32_t src_stride, uint32_t scale,
+                                    const R2DColorBitShift& src_shift,
+                                    const R2DColorBitShift& dst_shift) {
+    bool convert = src_shift.r != dst_shift.r || src_shift.g != dst_shift.g ||
+                   src_shift.b != dst_shift.b || src_shift.a != dst_shift.a;
+    uint32_t num_src_cols = (dst_width + scale - 1) / scale;
+
+    for (uint32_t y = 0; y < dst_height; y += scale) {
+        const R2DColor8* src_row = src_image + (size_t)(y / scale) * src_stride;
+        R2DColor8* dst_row = dst_image + (size_t)y * dst_stride;
+
+        for (uint32_t sx = 0; sx < num_src_cols; sx++) {
+            R2DColor8 color = src_row[sx];
+            if (convert)
+                color = r2d_swizzle_color(color, src_shift, dst_shift);
+
+            R2DColor8* dst = dst_row + sx * scale;
+            uint32_t run = r2d_min(scale, dst_width - sx * scale);
+            uint32_t i = 0;
+            if (run >= 4) {
+                __m128i col = _mm_set1_epi32(color);
+                for (; i + 4 <= run; i += 4) {
+                    _mm_storeu_si128((__m128i*)(dst + i), col);
+                }
+            }
+            for (; i < run; i++) {
+                dst[i] = color;
+            }
+        }
+
+        uint32_t num_rows = r2d_min(scale, dst_height - y);
+        for (uint32_t i = 1; i < num_rows; i++) {
+            std::memcpy(dst_row + (size_t)i * dst_stride, dst_row, dst_width * sizeof(R2DColor8));
+        }
     }
 }
 
@@ -163,6 +449,14 @@ static uint32_t r2d_fpmul(uint32_t a, uint32_t b) noexcept {
     return (val + (val >> 8)) >> 8;
 }
 
+// 8-bit coverage of a pixel covered horizontally from `x0` to `x1` (0-256 within the pixel) and
+// `cover_y` (0-256) vertically. The edge areas are rounded the same way as in the raster.
+R2D_FORCEINLINE
+static uint32_t r2d_area_coverage(int32_t x0, int32_t x1, int32_t cover_y) noexcept {
+    uint32_t coverage = (uint32_t)(((x1 * cover_y) >> 8) - ((x0 * cover_y) >> 8));
+    return coverage > 255 ? 255 : coverage;
+}
+
 R2D_FORCEINLINE
 static uint32_t r2d_rgb_alphamult(uint32_t col, uint32_t alpha) noexcept {
     uint32_t a = (0xFF00FF & col) * alpha + 0x800080;
@@ -174,28 +468,36 @@ static uint32_t r2d_rgb_alphamult(uint32_t col, uint32_t alpha) noexcept {
     return a | b;
 }
 
+// Reciprocals of the alpha values, used to unpremultiply colors without dividing per pixel
+struct R2DAlphaRcpTable {
+    uint16_t rcp[256]{}; // (0xFE01 + a / 2) / a, the 8.8 fixed-point factor of r2d_alpharcp()
+    uint32_t div[256]{}; // ceil(2^24 / a), x / a == (x * div[a]) >> 24 for any x < 2^16
+
+    constexpr R2DAlphaRcpTable() noexcept {
+        for (uint32_t a = 1; a < 256; a++) {
+            rcp[a] = (uint16_t)((0xFE01 + (a >> 1)) / a);
+            div[a] = ((1u << 24) + a - 1) / a;
+        }
+    }
+};
+
+inline constexpr R2DAlphaRcpTable r2d_alpharcp_table{};
+
 R2D_FORCEINLINE
 static uint32_t r2d_alpharcp(uint32_t alpha) noexcept {
-    if (alpha == 0)
-        return 0;
-    return (0xFE01 + (alpha >> 1)) / alpha;
+    return r2d_alpharcp_table.rcp[alpha];
 }
 
 R2D_FORCEINLINE
 static uint32_t r2d_rgb_alphadiv(uint32_t col, uint32_t alpha) noexcept {
-    if (alpha == 0)
-        return 0;
-    uint32_t a = (0xFF00FF & col) * 255;
-    uint32_t b = (0x00FF00 & col) * 255;
-    a += ((alpha >> 1) | (alpha << 15)) & 0xFF00FF;
-    b += (alpha << 7) & 0x00FF00;
-    uint32_t r = (a & 0xFFFF) / alpha;
-    uint32_t bb = (a / alpha) & 0xFF0000;
-    uint32_t g = (b / alpha) & 0x00FF00;
-    // a = (a / alpha) & 0xFF00FF;
-    // b = (b / alpha) & 0x00FF00;
-    return r | g | bb;
-    // return a | b;
+    // (c * 255 + alpha / 2) / alpha for each channel. The red channel is not masked, so it
+    // overflows into green if the color is larger than alpha.
+    uint64_t div = r2d_alpharcp_table.div[alpha];
+    uint32_t half = alpha >> 1;
+    uint32_t r = (uint32_t)(((0xFF & col) * 255 + half) * div >> 24);
+    uint32_t g = (uint32_t)(((0xFF & (col >> 8)) * 255 + half) * div >> 24);
+    uint32_t b = (uint32_t)(((0xFF & (col >> 16)) * 255 + half) * div >> 24);
+    return r | ((g & 0xFF) << 8) | ((b & 0xFF) << 16);
 }
 
 // Separate alpha and rearrange color channels in RGB order
@@ -210,9 +512,295 @@ static R2DColor8 r2d_separate_alpha(R2DColor8 color, uint32_t r_shift, uint32_t
     return r | (g << 8) | (b << 16);
 }
 
+// SIMD helpers operating on two pixels unpacked into 16-bit RGBA lanes
+
+// Mask of the alpha lanes
+R2D_FORCEINLINE
+static __m128i r2d_alpha_mask_epi16() noexcept {
+    return _mm_setr_epi16(0, 0, 0, -1, 0, 0, 0, -1);
+}
+
+// Same as r2d_fpmul() on every lane. Exact as long as a * b + 0x80 fits into 16 bits.
+R2D_FORCEINLINE
+static __m128i r2d_fpmul_epu16(__m128i a, __m128i b) noexcept {
+    __m128i val = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(val, _mm_srli_epi16(val, 8)), 8);
+}
+
+// Copy the alpha lane of each pixel into its color lanes
+R2D_FORCEINLINE
+static __m128i r2d_broadcast_alpha_epi16(__m128i color) noexcept {
+    return _mm_shufflehi_epi16(_mm_shufflelo_epi16(color, 0xFF), 0xFF);
+}
+
+// Replace the alpha lanes of `color` with the alpha lanes of `alpha`
+R2D_FORCEINLINE
+static __m128i r2d_set_alpha_epi16(__m128i color, __m128i alpha) noexcept {
+    __m128i mask = r2d_alpha_mask_epi16();
+    return _mm_or_si128(_mm_andnot_si128(mask, color), _mm_and_si128(mask, alpha));
+}
+
+// Turn premultiplied colors back into straight colors with the broadcasted `alpha`, this is the
+// same as r2d_rgb_alphamult(color, r2d_alpharcp(alpha)).
+R2D_FORCEINLINE
+static __m128i r2d_unpremultiply_epu16(__m128i color, __m128i alpha) noexcept {
+    uint32_t alpha0 = (uint32_t)_mm_extract_epi16(alpha, 0);
+    uint32_t alpha1 = (uint32_t)_mm_extract_epi16(alpha, 4);
+    __m128i rcp = _mm_cvtsi32_si128(r2d_alpharcp_table.rcp[alpha0]);
+    rcp = _mm_insert_epi16(rcp, r2d_alpharcp_table.rcp[alpha1], 4);
+    rcp = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rcp, 0), 0);
+    return r2d_set_alpha_epi16(r2d_fpmul_epu16(color, rcp), alpha);
+}
+
+// Multiply all four channels by `alpha` with the same rounding as r2d_fpmul()
+R2D_FORCEINLINE
+static uint32_t r2d_rgba_alphamult(uint32_t col, uint32_t alpha) noexcept {
+    uint32_t rb = (0xFF00FF & col) * alpha + 0x800080;
+    uint32_t ag = (0xFF00FF & (col >> 8)) * alpha + 0x800080;
+    rb = ((rb + ((rb >> 8) & 0xFF00FF)) >> 8) & 0xFF00FF;
+    ag = (ag + ((ag >> 8) & 0xFF00FF)) & 0xFF00FF00;
+    return rb | ag;
+}
+
+// Convert a straight RGBA color (alpha in the top byte) into premultiplied alpha and back
+R2D_FORCEINLINE
+static R2DColor8 r2d_premultiply(R2DColor8 color) noexcept {
+    uint32_t alpha = color >> 24;
+    return r2d_rgb_alphamult(color & 0xFFFFFF, alpha) | (alpha << 24);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_unpremultiply(R2DColor8 color) noexcept {
+    uint32_t alpha = color >> 24;
+    return r2d_rgb_alphamult(color & 0xFFFFFF, r2d_alpharcp(alpha)) | (alpha << 24);
+}
+
+// Premultiply two pixels in 16-bit lanes, the alpha lanes are kept
+R2D_FORCEINLINE
+static __m128i r2d_premultiply_epu16(__m128i color) noexcept {
+    return r2d_set_alpha_epi16(r2d_fpmul_epu16(color, r2d_broadcast_alpha_epi16(color)), color);
+}
+
+// Premultiply or unpremultiply a row of pixels in place. `alpha_shift` is the bit position of
+// the alpha channel, which is either 24 or 0. The other channels may be in any order.
+template <bool Premultiply>
+static void r2d_convert_alpha_row(R2DColor8* pixels, size_t count, uint32_t alpha_shift) noexcept {
+    // Rotate the alpha channel into the top byte
+    uint32_t rotate = (24 - alpha_shift) & 31;
+    auto rotate_left = [](uint32_t x, uint32_t n) { return n ? (x << n) | (x >> (32 - n)) : x; };
+    __m128i zero = _mm_setzero_si128();
+    __m128i rotate_in = _mm_cvtsi32_si128((int)rotate);
+    __m128i rotate_out = _mm_cvtsi32_si128((int)((32 - rotate) & 31));
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i px = _mm_loadu_si128((const __m128i*)(pixels + i));
+        if (rotate)
+            px = _mm_or_si128(_mm_sll_epi32(px, rotate_in), _mm_srl_epi32(px, rotate_out));
+        __m128i lo = _mm_unpacklo_epi8(px, zero);
+        __m128i hi = _mm_unpackhi_epi8(px, zero);
+        if constexpr (Premultiply) {
+            lo = r2d_premultiply_epu16(lo);
+            hi = r2d_premultiply_epu16(hi);
+        } else {
+            lo = r2d_unpremultiply_epu16(lo, r2d_broadcast_alpha_epi16(lo));
+            hi = r2d_unpremultiply_epu16(hi, r2d_broadcast_alpha_epi16(hi));
+        }
+        px = _mm_packus_epi16(lo, hi);
+        if (rotate)
+            px = _mm_or_si128(_mm_srl_epi32(px, rotate_in), _mm_sll_epi32(px, rotate_out));
+        _mm_storeu_si128((__m128i*)(pixels + i), px);
+    }
+
+    for (; i < count; i++) {
+        uint32_t color = rotate_left(pixels[i], rotate);
+        color = Premultiply ? r2d_premultiply(color) : r2d_unpremultiply(color);
+        pixels[i] = rotate_left(color, (32 - rotate) & 31);
+    }
+}
+
+// 4x4 ordered dithering threshold matrix
+inline constexpr uint8_t r2d_bayer4x4[16] = {
+    0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5,
+};
+
+// Unpack an RGB565 pixel into an opaque RGBA color. The channels are expanded by replicating their
+// top bits, so packing the color again without dithering gives back the same pixel.
+R2D_FORCEINLINE
+static R2DColor8 r2d_unpack_rgb565(uint32_t pixel) noexcept {
+    uint32_t r = (pixel >> 11) & 0x1F;
+    uint32_t g = (pixel >> 5) & 0x3F;
+    uint32_t b = pixel & 0x1F;
+    return R2D_COLOR_CHANNEL_4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255);
+}
+
+// Pack an RGBA color into RGB565 by truncating the channels
+R2D_FORCEINLINE
+static uint16_t r2d_pack_rgb565(R2DColor8 color) noexcept {
+    uint32_t r = color & 0xFF;
+    uint32_t g = (color >> 8) & 0xFF;
+    uint32_t b = (color >> 16) & 0xFF;
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+// Pack an RGBA color into RGB565 with ordered dithering. `dither` holds the offsets that are
+// added to each channel, in the same byte order as `color`, below one 5/6-bit step. The channels
+// are first scaled by 31/32 and 63/64, which maps every unpacked RGB565 value to an exact
+// multiple of the step, so pixels that are already representable never change.
+R2D_FORCEINLINE
+static uint16_t r2d_pack_rgb565_dithered(R2DColor8 color, R2DColor8 dither) noexcept {
+    uint32_t r = color & 0xFF;
+    uint32_t g = (color >> 8) & 0xFF;
+    uint32_t b = (color >> 16) & 0xFF;
+    r = r2d_min(r - (r >> 5) + (dither & 0xFF), 255u);
+    g = r2d_min(g - (g >> 6) + ((dither >> 8) & 0xFF), 255u);
+    b = r2d_min(b - (b >> 5) + ((dither >> 16) & 0xFF), 255u);
+    return (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+}
+
+// SIMD variants of r2d_unpack_rgb565() and r2d_pack_rgb565_dithered() for four pixels, the
+// RGB565 pixels are zero-extended into 32-bit lanes
+R2D_FORCEINLINE
+static __m128i r2d_unpack_rgb565_epi32(__m128i pixels) noexcept {
+    __m128i r = _mm_srli_epi32(pixels, 11);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(pixels, 5), _mm_set1_epi32(0x3F));
+    __m128i b = _mm_and_si128(pixels, _mm_set1_epi32(0x1F));
+    r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+    g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+    b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+    __m128i rg = _mm_or_si128(r, _mm_slli_epi32(g, 8));
+    __m128i ba = _mm_or_si128(_mm_slli_epi32(b, 16), _mm_set1_epi32((int)0xFF000000));
+    return _mm_or_si128(rg, ba);
+}
+
+template <bool Dither>
+R2D_FORCEINLINE static __m128i r2d_pack_rgb565_epi32(__m128i color, __m128i dither) noexcept {
+    if constexpr (Dither) {
+        __m128i rb = _mm_and_si128(_mm_srli_epi32(color, 5), _mm_set1_epi32(0x070007));
+        __m128i g = _mm_and_si128(_mm_srli_epi32(color, 6), _mm_set1_epi32(0x0300));
+        color = _mm_adds_epu8(_mm_sub_epi8(color, _mm_or_si128(rb, g)), dither);
+    }
+    __m128i r = _mm_slli_epi32(_mm_and_si128(color, _mm_set1_epi32(0xF8)), 8);
+    __m128i g = _mm_and_si128(_mm_srli_epi32(color, 5), _mm_set1_epi32(0x7E0));
+    __m128i b = _mm_and_si128(_mm_srli_epi32(color, 19), _mm_set1_epi32(0x1F));
+    return _mm_or_si128(r, _mm_or_si128(g, b));
+}
+
+// Unpack a row of RGB565 pixels into opaque RGBA colors
+static void r2d_unpack_rgb565_row(R2DColor8* dst, const uint16_t* src, size_t count) noexcept {
+    __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = r2d_unpack_rgb565_epi32(_mm_unpacklo_epi16(pixels, zero));
+        __m128i hi = r2d_unpack_rgb565_epi32(_mm_unpackhi_epi16(pixels, zero));
+        _mm_storeu_si128((__m128i*)(dst + i), lo);
+        _mm_storeu_si128((__m128i*)(dst + i + 4), hi);
+    }
+    for (; i < count; i++)
+        dst[i] = r2d_unpack_rgb565(src[i]);
+}
+
+// Pack a row of RGBA colors into RGB565 pixels. Pixels whose `mask` is 0 are left untouched, all
+// pixels are written if `mask` is null. With `Dither`, `dither` holds four offsets that repeat
+// along the row, starting from the first pixel.
+template <bool Dither>
+static void r2d_pack_rgb565_row(uint16_t* dst, const R2DColor8* src, const uint8_t* mask,
+                                size_t count, const R2DColor8* dither) noexcept {
+    __m128i zero = _mm_setzero_si128();
+    __m128i dither4 = Dither ? _mm_loadu_si128((const __m128i*)dither) : zero;
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = r2d_pack_rgb565_epi32<Dither>(_mm_loadu_si128((const __m128i*)(src + i)),
+                                                   dither4);
+        __m128i hi = r2d_pack_rgb565_epi32<Dither>(_mm_loadu_si128((const __m128i*)(src + i + 4)),
+                                                   dither4);
+        // Sign-extend so the signed saturating pack keeps all 16 bits
+        lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+        __m128i pixels = _mm_packs_epi32(lo, hi);
+        if (mask) {
+            __m128i mask8 = _mm_loadl_epi64((const __m128i*)(mask + i));
+            __m128i keep = _mm_cmpeq_epi16(_mm_unpacklo_epi8(mask8, zero), zero);
+            __m128i old = _mm_loadu_si128((const __m128i*)(dst + i));
+            pixels = _mm_or_si128(_mm_and_si128(keep, old), _mm_andnot_si128(keep, pixels));
+        }
+        _mm_storeu_si128((__m128i*)(dst + i), pixels);
+    }
+    for (; i < count; i++) {
+        if (mask && !mask[i])
+            continue;
+        if constexpr (Dither)
+            dst[i] = r2d_pack_rgb565_dithered(src[i], dither[i & 3]);
+        else
+            dst[i] = r2d_pack_rgb565(src[i]);
+    }
+}
+
+// Convert an RGB color into BT.601 limited range YUV, Y in the low byte followed by U and V.
+// The alpha channel is ignored.
+R2D_FORCEINLINE
+static R2DColor8 r2d_rgb_to_yuv(R2DColor8 color) noexcept {
+    int32_t r = color & 0xFF;
+    int32_t g = (color >> 8) & 0xFF;
+    int32_t b = (color >> 16) & 0xFF;
+    int32_t y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+    int32_t u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+    int32_t v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+    return R2D_COLOR_CHANNEL_4(y, u, v, 0);
+}
+
+// Inverse of r2d_rgb_to_yuv(), the result is an opaque RGBA color
+R2D_FORCEINLINE
+static R2DColor8 r2d_yuv_to_rgb(uint32_t y, uint32_t u, uint32_t v) noexcept {
+    int32_t c = 298 * ((int32_t)y - 16) + 128;
+    int32_t d = (int32_t)u - 128;
+    int32_t e = (int32_t)v - 128;
+    int32_t r = r2d_clamp((c + 409 * e) >> 8, 0, 255);
+    int32_t g = r2d_clamp((c - 100 * d - 208 * e) >> 8, 0, 255);
+    int32_t b = r2d_clamp((c + 516 * d) >> 8, 0, 255);
+    return R2D_COLOR_CHANNEL_4(r, g, b, 255);
+}
+
+// Interpolate between the destination and the blended color by `coverage` in premultiplied space
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_coverage(R2DColor8 col, uint32_t alpha, R2DColor8 dst_col,
+                                    uint32_t dst_a, uint32_t coverage,
+                                    uint32_t& out_alpha) noexcept {
+    uint32_t src_factor = r2d_fpmul(alpha, coverage);
+    uint32_t dst_factor = r2d_fpmul(dst_a, 255 - coverage);
+    uint32_t src = r2d_rgb_alphamult(col, src_factor);
+    uint32_t dst = r2d_rgb_alphamult(dst_col, dst_factor);
+    out_alpha = src_factor + dst_factor;
+    return r2d_rgb_alphamult(src + dst, r2d_alpharcp(out_alpha));
+}
+
+// SIMD variant of r2d_blend_coverage(), `coverage` is broadcasted over the lanes of each pixel
+R2D_FORCEINLINE
+static __m128i r2d_blend_coverage_epu16(__m128i color, __m128i dst, __m128i coverage) noexcept {
+    __m128i src_factor = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(color), coverage);
+    __m128i dst_factor = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(dst),
+                                         _mm_sub_epi16(_mm_set1_epi16(255), coverage));
+    __m128i src = r2d_fpmul_epu16(color, src_factor);
+    __m128i dst_pre = r2d_fpmul_epu16(dst, dst_factor);
+    return r2d_unpremultiply_epu16(_mm_add_epi16(src, dst_pre),
+                                   _mm_add_epi16(src_factor, dst_factor));
+}
+
+// Blend functors. The scalar variant takes straight alpha colors with the RGB channels packed in
+// the low 24 bits and returns the straight alpha result. The SIMD variant blends two pixels held
+// in 16-bit RGBA lanes and rounds exactly like the scalar variant.
+//
+// `fold_coverage` is set for modes that leave the destination unchanged when the source is fully
+// transparent, the pixel coverage can then be applied by scaling the source alpha. The result of
+// other modes is interpolated between the destination and the blended color by the coverage.
+
 struct R2DBlendSrcOver {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
-                                         uint32_t dst_a, uint32_t& out_alpha) {
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
         uint32_t dst_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
         uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
         uint32_t src = r2d_rgb_alphamult(src_col, src_a);
@@ -221,9 +809,21 @@ struct R2DBlendSrcOver {
         out_alpha = alpha;
         return r2d_rgb_alphamult(src + dst, alpha_rcp);
     }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_alpha_factor = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(dst),
+                                                   _mm_sub_epi16(_mm_set1_epi16(255), src_a));
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_a),
+                                    r2d_fpmul_epu16(dst, dst_alpha_factor));
+        return r2d_unpremultiply_epu16(sum, _mm_add_epi16(src_a, dst_alpha_factor));
+    }
 };
 
 struct R2DBlendSrcAtop {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                          uint32_t dst_a, uint32_t& out_alpha) noexcept {
         uint32_t src_alpha_factor = r2d_fpmul(src_a, dst_a);
@@ -235,9 +835,23 @@ struct R2DBlendSrcAtop {
         out_alpha = alpha;
         return r2d_rgb_alphamult(src + dst, alpha_rcp);
     }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i src_alpha_factor = r2d_fpmul_epu16(src_a, dst_a);
+        __m128i dst_alpha_factor =
+            r2d_fpmul_epu16(dst_a, _mm_sub_epi16(_mm_set1_epi16(255), src_a));
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_alpha_factor),
+                                    r2d_fpmul_epu16(dst, dst_alpha_factor));
+        return r2d_unpremultiply_epu16(sum, _mm_add_epi16(src_alpha_factor, dst_alpha_factor));
+    }
 };
 
 struct R2DBlendSrcIn {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                          uint32_t dst_a, uint32_t& out_alpha) noexcept {
         uint32_t alpha = r2d_fpmul(src_a, dst_a);
@@ -246,9 +860,18 @@ struct R2DBlendSrcIn {
         out_alpha = alpha;
         return r2d_rgb_alphamult(src, alpha_rcp);
     }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i alpha =
+            r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(src), r2d_broadcast_alpha_epi16(dst));
+        return r2d_unpremultiply_epu16(r2d_fpmul_epu16(src, alpha), alpha);
+    }
 };
 
 struct R2DBlendSrcOut {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                          uint32_t dst_a, uint32_t& out_alpha) noexcept {
         uint32_t alpha = r2d_fpmul(src_a, 255 - dst_a);
@@ -257,73 +880,981 @@ struct R2DBlendSrcOut {
         out_alpha = alpha;
         return r2d_rgb_alphamult(src, alpha_rcp);
     }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i dst_inv_a = _mm_sub_epi16(_mm_set1_epi16(255), r2d_broadcast_alpha_epi16(dst));
+        __m128i alpha = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(src), dst_inv_a);
+        return r2d_unpremultiply_epu16(r2d_fpmul_epu16(src, alpha), alpha);
+    }
 };
 
 struct R2DBlendSrcCopy {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                          uint32_t dst_a, uint32_t& out_alpha) noexcept {
         out_alpha = src_a;
-        return 0;
+        return src_col;
     }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept { return src; }
 };
 
 struct R2DBlendDstOver {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
     R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                          uint32_t dst_a, uint32_t& out_alpha) noexcept {
-        uint32_t src_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
+        uint32_t src_alpha_factor = r2d_fpmul(src_a, 255 - dst_a);
+        uint32_t src = r2d_rgb_alphamult(src_col, src_alpha_factor);
         uint32_t dst = r2d_rgb_alphamult(dst_col, dst_a);
-        uint32_t src = r2d_rgb_alphamult(src_col, src_a);
         uint32_t alpha = src_alpha_factor + dst_a;
-        // uint32_t alpha_rcp = r2d_alpharcp(ao);
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
+        out_alpha = alpha;
+        return r2d_rgb_alphamult(src + dst, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i src_alpha_factor = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(src),
+                                                   _mm_sub_epi16(_mm_set1_epi16(255), dst_a));
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_alpha_factor),
+                                    r2d_fpmul_epu16(dst, dst_a));
+        return r2d_unpremultiply_epu16(sum, _mm_add_epi16(src_alpha_factor, dst_a));
+    }
+};
+
+struct R2DBlendDstAtop {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        uint32_t src_alpha_factor = r2d_fpmul(src_a, 255 - dst_a);
+        uint32_t dst_alpha_factor = r2d_fpmul(dst_a, src_a);
+        uint32_t src = r2d_rgb_alphamult(src_col, src_alpha_factor);
+        uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
+        uint32_t alpha = src_alpha_factor + dst_alpha_factor;
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
+        out_alpha = alpha;
+        return r2d_rgb_alphamult(src + dst, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i src_alpha_factor =
+            r2d_fpmul_epu16(src_a, _mm_sub_epi16(_mm_set1_epi16(255), dst_a));
+        __m128i dst_alpha_factor = r2d_fpmul_epu16(dst_a, src_a);
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_alpha_factor),
+                                    r2d_fpmul_epu16(dst, dst_alpha_factor));
+        return r2d_unpremultiply_epu16(sum, _mm_add_epi16(src_alpha_factor, dst_alpha_factor));
+    }
+};
+
+struct R2DBlendDstIn {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        uint32_t alpha = r2d_fpmul(dst_a, src_a);
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
+        uint32_t dst = r2d_rgb_alphamult(dst_col, alpha);
+        out_alpha = alpha;
+        return r2d_rgb_alphamult(dst, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i alpha =
+            r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(dst), r2d_broadcast_alpha_epi16(src));
+        return r2d_unpremultiply_epu16(r2d_fpmul_epu16(dst, alpha), alpha);
+    }
+};
+
+struct R2DBlendDstOut {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        uint32_t alpha = r2d_fpmul(dst_a, 255 - src_a);
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
+        uint32_t dst = r2d_rgb_alphamult(dst_col, alpha);
+        out_alpha = alpha;
+        return r2d_rgb_alphamult(dst, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_inv_a = _mm_sub_epi16(_mm_set1_epi16(255), r2d_broadcast_alpha_epi16(src));
+        __m128i alpha = r2d_fpmul_epu16(r2d_broadcast_alpha_epi16(dst), src_inv_a);
+        return r2d_unpremultiply_epu16(r2d_fpmul_epu16(dst, alpha), alpha);
+    }
+};
+
+struct R2DBlendDstCopy {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        out_alpha = dst_a;
+        return dst_col;
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept { return dst; }
+};
+
+struct R2DBlendClear {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = false;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        out_alpha = 0;
+        return 0;
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        return _mm_setzero_si128();
+    }
+};
+
+struct R2DBlendXor {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        uint32_t src_alpha_factor = r2d_fpmul(src_a, 255 - dst_a);
+        uint32_t dst_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
+        uint32_t src = r2d_rgb_alphamult(src_col, src_alpha_factor);
+        uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
+        uint32_t alpha = src_alpha_factor + dst_alpha_factor;
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
         out_alpha = alpha;
-        return r2d_rgb_alphadiv(src + dst, alpha);
+        return r2d_rgb_alphamult(src + dst, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i src_alpha_factor =
+            r2d_fpmul_epu16(src_a, _mm_sub_epi16(_mm_set1_epi16(255), dst_a));
+        __m128i dst_alpha_factor =
+            r2d_fpmul_epu16(dst_a, _mm_sub_epi16(_mm_set1_epi16(255), src_a));
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_alpha_factor),
+                                    r2d_fpmul_epu16(dst, dst_alpha_factor));
+        return r2d_unpremultiply_epu16(sum, _mm_add_epi16(src_alpha_factor, dst_alpha_factor));
     }
 };
 
+// Separable blend modes. The blend function B(dst, src) of each channel is mixed into the
+// source-over composite: co = cs * as * (1 - ab) + cb * ab * (1 - as) + B(cb, cs) * as * ab.
+template <typename BlendOpT>
+struct R2DBlendSeparable {
+    static constexpr bool premultiplied = false;
+    static constexpr bool fold_coverage = true;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                         uint32_t dst_a, uint32_t& out_alpha) noexcept {
+        uint32_t src_alpha_factor = r2d_fpmul(src_a, 255 - dst_a);
+        uint32_t dst_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
+        uint32_t both_alpha_factor = r2d_fpmul(src_a, dst_a);
+        R2DColor8 blend_col = 0;
+        for (uint32_t shift = 0; shift < 24; shift += 8) {
+            uint32_t cb = (dst_col >> shift) & 0xFF;
+            uint32_t cs = (src_col >> shift) & 0xFF;
+            blend_col |= BlendOpT::blend(cb, cs) << shift;
+        }
+        uint32_t src = r2d_rgb_alphamult(src_col, src_alpha_factor);
+        uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
+        uint32_t both = r2d_rgb_alphamult(blend_col, both_alpha_factor);
+        uint32_t alpha = src_alpha_factor + dst_alpha_factor + both_alpha_factor;
+        uint32_t alpha_rcp = r2d_alpharcp(alpha);
+        out_alpha = alpha;
+        return r2d_rgb_alphamult(src + dst + both, alpha_rcp);
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i one = _mm_set1_epi16(255);
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i src_alpha_factor = r2d_fpmul_epu16(src_a, _mm_sub_epi16(one, dst_a));
+        __m128i dst_alpha_factor = r2d_fpmul_epu16(dst_a, _mm_sub_epi16(one, src_a));
+        __m128i both_alpha_factor = r2d_fpmul_epu16(src_a, dst_a);
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(src, src_alpha_factor),
+                                    r2d_fpmul_epu16(dst, dst_alpha_factor));
+        sum = _mm_add_epi16(sum, r2d_fpmul_epu16(BlendOpT::blend(dst, src), both_alpha_factor));
+        __m128i alpha = _mm_add_epi16(_mm_add_epi16(src_alpha_factor, dst_alpha_factor),
+                                      both_alpha_factor);
+        return r2d_unpremultiply_epu16(sum, alpha);
+    }
+};
+
+// Blend functions of the separable modes, on single channels and on 16-bit lanes
+
+struct R2DBlendOpMultiply {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept { return r2d_fpmul(cb, cs); }
+    static __m128i blend(__m128i cb, __m128i cs) noexcept { return r2d_fpmul_epu16(cb, cs); }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        return (int32_t)r2d_fpmul(s, d);
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return r2d_fpmul_epu16(s, d);
+    }
+};
+
+struct R2DBlendOpScreen {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept {
+        return cb + cs - r2d_fpmul(cb, cs);
+    }
+
+    static __m128i blend(__m128i cb, __m128i cs) noexcept {
+        return _mm_sub_epi16(_mm_add_epi16(cb, cs), r2d_fpmul_epu16(cb, cs));
+    }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        return (int32_t)(r2d_fpmul(s, da) + r2d_fpmul(d, sa)) - (int32_t)r2d_fpmul(s, d);
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i sum = _mm_add_epi16(r2d_fpmul_epu16(s, da), r2d_fpmul_epu16(d, sa));
+        return _mm_sub_epi16(sum, r2d_fpmul_epu16(s, d));
+    }
+};
+
+// Multiply or screen depending on the destination channel
+struct R2DBlendOpOverlay {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept {
+        uint32_t cb2 = cb * 2;
+        if (cb2 <= 255)
+            return r2d_fpmul(cs, cb2);
+        return R2DBlendOpScreen::blend(cb2 - 255, cs);
+    }
+
+    static __m128i blend(__m128i cb, __m128i cs) noexcept {
+        __m128i cb2 = _mm_slli_epi16(cb, 1);
+        __m128i multiply = r2d_fpmul_epu16(cs, cb2);
+        __m128i screen = R2DBlendOpScreen::blend(_mm_sub_epi16(cb2, _mm_set1_epi16(255)), cs);
+        __m128i upper = _mm_cmpgt_epi16(cb2, _mm_set1_epi16(255));
+        return _mm_or_si128(_mm_and_si128(upper, screen), _mm_andnot_si128(upper, multiply));
+    }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        if (d * 2 <= da)
+            return (int32_t)r2d_fpmul(s, d) * 2;
+        return (int32_t)r2d_fpmul(sa, da) -
+               (int32_t)r2d_fpmul(r2d_max(da - d, 0), r2d_max(sa - s, 0)) * 2;
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i zero = _mm_setzero_si128();
+        __m128i lower = _mm_slli_epi16(r2d_fpmul_epu16(s, d), 1);
+        __m128i inv_d = _mm_max_epi16(_mm_sub_epi16(da, d), zero);
+        __m128i inv_s = _mm_max_epi16(_mm_sub_epi16(sa, s), zero);
+        __m128i upper = _mm_sub_epi16(r2d_fpmul_epu16(sa, da),
+                                      _mm_slli_epi16(r2d_fpmul_epu16(inv_d, inv_s), 1));
+        __m128i is_upper = _mm_cmpgt_epi16(_mm_slli_epi16(d, 1), da);
+        return _mm_or_si128(_mm_and_si128(is_upper, upper), _mm_andnot_si128(is_upper, lower));
+    }
+};
+
+struct R2DBlendOpDarken {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept { return r2d_min(cb, cs); }
+    static __m128i blend(__m128i cb, __m128i cs) noexcept { return _mm_min_epi16(cb, cs); }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        return (int32_t)r2d_min(r2d_fpmul(s, da), r2d_fpmul(d, sa));
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return _mm_min_epi16(r2d_fpmul_epu16(s, da), r2d_fpmul_epu16(d, sa));
+    }
+};
+
+struct R2DBlendOpLighten {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept { return r2d_max(cb, cs); }
+    static __m128i blend(__m128i cb, __m128i cs) noexcept { return _mm_max_epi16(cb, cs); }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        return (int32_t)r2d_max(r2d_fpmul(s, da), r2d_fpmul(d, sa));
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return _mm_max_epi16(r2d_fpmul_epu16(s, da), r2d_fpmul_epu16(d, sa));
+    }
+};
+
+struct R2DBlendOpDifference {
+    static uint32_t blend(uint32_t cb, uint32_t cs) noexcept {
+        return cb > cs ? cb - cs : cs - cb;
+    }
+
+    static __m128i blend(__m128i cb, __m128i cs) noexcept {
+        return _mm_sub_epi16(_mm_max_epi16(cb, cs), _mm_min_epi16(cb, cs));
+    }
+
+    static int32_t premul_blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        int32_t x = (int32_t)r2d_fpmul(s, da);
+        int32_t y = (int32_t)r2d_fpmul(d, sa);
+        return x > y ? x - y : y - x;
+    }
+
+    static __m128i premul_blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i x = r2d_fpmul_epu16(s, da);
+        __m128i y = r2d_fpmul_epu16(d, sa);
+        return _mm_sub_epi16(_mm_max_epi16(x, y), _mm_min_epi16(x, y));
+    }
+};
+
+using R2DBlendMultiply = R2DBlendSeparable<R2DBlendOpMultiply>;
+using R2DBlendScreen = R2DBlendSeparable<R2DBlendOpScreen>;
+using R2DBlendOverlay = R2DBlendSeparable<R2DBlendOpOverlay>;
+using R2DBlendDarken = R2DBlendSeparable<R2DBlendOpDarken>;
+using R2DBlendLighten = R2DBlendSeparable<R2DBlendOpLighten>;
+using R2DBlendDifference = R2DBlendSeparable<R2DBlendOpDifference>;
+
+// Blend functors of premultiplied render targets. Both the source and the destination are
+// premultiplied RGBA colors, every channel including alpha goes through the same formula so no
+// division is needed. The scalar variant clamps like the saturating pack of the SIMD variant.
+template <typename BlendOpT>
+struct R2DBlendPremultiplied {
+    static constexpr bool premultiplied = true;
+    static constexpr bool fold_coverage = BlendOpT::fold_coverage;
+
+    R2D_FORCEINLINE R2DColor8 operator()(R2DColor8 src, R2DColor8 dst) noexcept {
+        int32_t src_a = (int32_t)(src >> 24);
+        int32_t dst_a = (int32_t)(dst >> 24);
+        R2DColor8 result = 0;
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            int32_t s = (int32_t)((src >> shift) & 0xFF);
+            int32_t d = (int32_t)((dst >> shift) & 0xFF);
+            int32_t c = shift == 24 ? BlendOpT::alpha(s, d) : BlendOpT::blend(s, d, src_a, dst_a);
+            result |= (uint32_t)r2d_clamp(c, 0, 255) << shift;
+        }
+        return result;
+    }
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i src_a = r2d_broadcast_alpha_epi16(src);
+        __m128i dst_a = r2d_broadcast_alpha_epi16(dst);
+        __m128i color = BlendOpT::blend(src, dst, src_a, dst_a);
+        __m128i alpha = BlendOpT::alpha(src_a, dst_a);
+        color = _mm_min_epi16(_mm_max_epi16(color, _mm_setzero_si128()), _mm_set1_epi16(255));
+        return r2d_set_alpha_epi16(color, _mm_min_epi16(alpha, _mm_set1_epi16(255)));
+    }
+};
+
+// Defines a premultiplied Porter-Duff operator, where the alpha channel follows the color formula
+#define R2D_PREMULTIPLIED_OP(name, fold, scalar_expr, simd_expr)                                   \
+    struct R2DBlendOpPremul##name {                                                                \
+        static constexpr bool fold_coverage = fold;                                                \
+        static int32_t blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {              \
+            return scalar_expr;                                                                    \
+        }                                                                                          \
+        static int32_t alpha(int32_t sa, int32_t da) noexcept { return blend(sa, da, sa, da); }    \
+        static __m128i blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {              \
+            return simd_expr;                                                                      \
+        }                                                                                          \
+        static __m128i alpha(__m128i sa, __m128i da) noexcept { return blend(sa, da, sa, da); }    \
+    };                                                                                             \
+    using R2DBlendPremul##name = R2DBlendPremultiplied<R2DBlendOpPremul##name>;
+
+#define R2D_INV(x) _mm_sub_epi16(_mm_set1_epi16(255), x)
+#define R2D_MUL(x, y) r2d_fpmul_epu16(x, y)
+#define R2D_ADD(x, y) _mm_add_epi16(x, y)
+
+// clang-format off
+R2D_PREMULTIPLIED_OP(SrcOver, true,
+                     s + (int32_t)r2d_fpmul(d, 255 - sa),
+                     R2D_ADD(s, R2D_MUL(d, R2D_INV(sa))))
+R2D_PREMULTIPLIED_OP(SrcAtop, true,
+                     (int32_t)(r2d_fpmul(s, da) + r2d_fpmul(d, 255 - sa)),
+                     R2D_ADD(R2D_MUL(s, da), R2D_MUL(d, R2D_INV(sa))))
+R2D_PREMULTIPLIED_OP(SrcIn, false,
+                     (int32_t)r2d_fpmul(s, da),
+                     R2D_MUL(s, da))
+R2D_PREMULTIPLIED_OP(SrcOut, false,
+                     (int32_t)r2d_fpmul(s, 255 - da),
+                     R2D_MUL(s, R2D_INV(da)))
+R2D_PREMULTIPLIED_OP(SrcCopy, false,
+                     s,
+                     s)
+R2D_PREMULTIPLIED_OP(DstOver, true,
+                     (int32_t)r2d_fpmul(s, 255 - da) + d,
+                     R2D_ADD(R2D_MUL(s, R2D_INV(da)), d))
+R2D_PREMULTIPLIED_OP(DstAtop, false,
+                     (int32_t)(r2d_fpmul(s, 255 - da) + r2d_fpmul(d, sa)),
+                     R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, sa)))
+R2D_PREMULTIPLIED_OP(DstIn, false,
+                     (int32_t)r2d_fpmul(d, sa),
+                     R2D_MUL(d, sa))
+R2D_PREMULTIPLIED_OP(DstOut, true,
+                     (int32_t)r2d_fpmul(d, 255 - sa),
+                     R2D_MUL(d, R2D_INV(sa)))
+R2D_PREMULTIPLIED_OP(DstCopy, true,
+                     d,
+                     d)
+R2D_PREMULTIPLIED_OP(Clear, false,
+                     0,
+                     _mm_setzero_si128())
+R2D_PREMULTIPLIED_OP(Xor, true,
+                     (int32_t)(r2d_fpmul(s, 255 - da) + r2d_fpmul(d, 255 - sa)),
+                     R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa))))
+// clang-format on
+
+// Separable modes on premultiplied colors: s * (1 - da) + d * (1 - sa) + sa * da * B(d/da, s/sa),
+// where the last term is rewritten without division by each blend function.
+template <typename BlendOpT>
+struct R2DBlendOpPremulSeparable {
+    static constexpr bool fold_coverage = true;
+
+    static int32_t blend(int32_t s, int32_t d, int32_t sa, int32_t da) noexcept {
+        return (int32_t)(r2d_fpmul(s, 255 - da) + r2d_fpmul(d, 255 - sa)) +
+               BlendOpT::premul_blend(s, d, sa, da);
+    }
+
+    static int32_t alpha(int32_t sa, int32_t da) noexcept {
+        return (int32_t)(r2d_fpmul(sa, 255 - da) + r2d_fpmul(da, 255 - sa) + r2d_fpmul(sa, da));
+    }
+
+    static __m128i blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i sum = R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa)));
+        return R2D_ADD(sum, BlendOpT::premul_blend(s, d, sa, da));
+    }
+
+    static __m128i alpha(__m128i sa, __m128i da) noexcept {
+        __m128i sum = R2D_ADD(R2D_MUL(sa, R2D_INV(da)), R2D_MUL(da, R2D_INV(sa)));
+        return R2D_ADD(sum, R2D_MUL(sa, da));
+    }
+};
+
+#undef R2D_PREMULTIPLIED_OP
+#undef R2D_INV
+#undef R2D_MUL
+#undef R2D_ADD
+
+using R2DBlendPremulMultiply = R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpMultiply>>;
+using R2DBlendPremulScreen = R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpScreen>>;
+using R2DBlendPremulOverlay = R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpOverlay>>;
+using R2DBlendPremulDarken = R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpDarken>>;
+using R2DBlendPremulLighten = R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpLighten>>;
+using R2DBlendPremulDifference =
+    R2DBlendPremultiplied<R2DBlendOpPremulSeparable<R2DBlendOpDifference>>;
+
+// Convert an RGBA8 color into normalized floats and back with rounding and clamping
+R2D_FORCEINLINE
+static __m128 r2d_color_to_ps(R2DColor8 color) noexcept {
+    __m128i zero = _mm_setzero_si128();
+    __m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128((int)color), zero);
+    c = _mm_unpacklo_epi16(c, zero);
+    return _mm_mul_ps(_mm_cvtepi32_ps(c), _mm_set1_ps(1.0f / 255.0f));
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_color_from_ps(__m128 color) noexcept {
+    color = _mm_min_ps(_mm_max_ps(color, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+    __m128i c = _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(255.0f)));
+    c = _mm_packs_epi32(c, c);
+    return (R2DColor8)_mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+}
+
+// Broadcast the alpha (last) lane of an RGBA float color
+R2D_FORCEINLINE
+static __m128 r2d_broadcast_alpha_ps(__m128 color) noexcept {
+    return _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 3, 3, 3));
+}
+
+// Replace the alpha lane of `color` with the alpha lane of `alpha`
+R2D_FORCEINLINE
+static __m128 r2d_set_alpha_ps(__m128 color, __m128 alpha) noexcept {
+    __m128 mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+    return r2d_select_ps(mask, alpha, color);
+}
+
+R2D_FORCEINLINE
+static __m128 r2d_premultiply_ps(__m128 color) noexcept {
+    return r2d_set_alpha_ps(_mm_mul_ps(color, r2d_broadcast_alpha_ps(color)), color);
+}
+
+// Fully transparent colors become zero
+R2D_FORCEINLINE
+static __m128 r2d_unpremultiply_ps(__m128 color) noexcept {
+    __m128 alpha = r2d_broadcast_alpha_ps(color);
+    __m128 rcp = _mm_div_ps(_mm_set1_ps(1.0f), alpha);
+    rcp = _mm_and_ps(rcp, _mm_cmpgt_ps(alpha, _mm_setzero_ps()));
+    return r2d_set_alpha_ps(_mm_mul_ps(color, rcp), alpha);
+}
+
+// Blend functors of float render targets. The colors are premultiplied RGBA floats in one
+// register, every lane goes through the same formula.
+template <typename BlendOpT>
+struct R2DBlendFloat {
+    static constexpr bool fold_coverage = BlendOpT::fold_coverage;
+
+    R2D_FORCEINLINE __m128 operator()(__m128 src, __m128 dst) noexcept {
+        return BlendOpT::blend(src, dst, r2d_broadcast_alpha_ps(src), r2d_broadcast_alpha_ps(dst));
+    }
+};
+
+// Defines a Porter-Duff operator on premultiplied float colors
+#define R2D_FLOAT_OP(name, fold, expr)                                                             \
+    struct R2DBlendOpFloat##name {                                                                 \
+        static constexpr bool fold_coverage = fold;                                                \
+        static __m128 blend(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {                   \
+            return expr;                                                                           \
+        }                                                                                          \
+    };                                                                                             \
+    using R2DBlendFloat##name = R2DBlendFloat<R2DBlendOpFloat##name>;
+
+#define R2D_INV(x) _mm_sub_ps(_mm_set1_ps(1.0f), x)
+#define R2D_MUL(x, y) _mm_mul_ps(x, y)
+#define R2D_ADD(x, y) _mm_add_ps(x, y)
+
+// clang-format off
+R2D_FLOAT_OP(SrcOver, true, R2D_ADD(s, R2D_MUL(d, R2D_INV(sa))))
+R2D_FLOAT_OP(SrcAtop, true, R2D_ADD(R2D_MUL(s, da), R2D_MUL(d, R2D_INV(sa))))
+R2D_FLOAT_OP(SrcIn, false, R2D_MUL(s, da))
+R2D_FLOAT_OP(SrcOut, false, R2D_MUL(s, R2D_INV(da)))
+R2D_FLOAT_OP(SrcCopy, false, s)
+R2D_FLOAT_OP(DstOver, true, R2D_ADD(R2D_MUL(s, R2D_INV(da)), d))
+R2D_FLOAT_OP(DstAtop, false, R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, sa)))
+R2D_FLOAT_OP(DstIn, false, R2D_MUL(d, sa))
+R2D_FLOAT_OP(DstOut, true, R2D_MUL(d, R2D_INV(sa)))
+R2D_FLOAT_OP(Clear, false, _mm_setzero_ps())
+R2D_FLOAT_OP(Xor, true, R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa))))
+// clang-format on
+
+// Separable modes: s * (1 - da) + d * (1 - sa) + B, where B is the blend term of each mode
+// rewritten on premultiplied colors. The alpha lane is always sa + da - sa * da.
+template <typename BlendTermT>
+struct R2DBlendOpFloatSeparable {
+    static constexpr bool fold_coverage = true;
+
+    static __m128 blend(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        __m128 sum = R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa)));
+        __m128 color = R2D_ADD(sum, BlendTermT::term(s, d, sa, da));
+        return r2d_set_alpha_ps(color, _mm_sub_ps(R2D_ADD(sa, da), R2D_MUL(sa, da)));
+    }
+};
+
+struct R2DBlendTermFloatMultiply {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept { return R2D_MUL(s, d); }
+};
+
+struct R2DBlendTermFloatScreen {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        return _mm_sub_ps(R2D_ADD(R2D_MUL(s, da), R2D_MUL(d, sa)), R2D_MUL(s, d));
+    }
+};
+
+struct R2DBlendTermFloatOverlay {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        __m128 lower = R2D_MUL(_mm_set1_ps(2.0f), R2D_MUL(s, d));
+        __m128 upper = R2D_MUL(_mm_set1_ps(2.0f), R2D_MUL(_mm_sub_ps(da, d), _mm_sub_ps(sa, s)));
+        upper = _mm_sub_ps(R2D_MUL(sa, da), upper);
+        return r2d_select_ps(_mm_cmpgt_ps(R2D_ADD(d, d), da), upper, lower);
+    }
+};
+
+struct R2DBlendTermFloatDarken {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        return _mm_min_ps(R2D_MUL(s, da), R2D_MUL(d, sa));
+    }
+};
+
+struct R2DBlendTermFloatLighten {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        return _mm_max_ps(R2D_MUL(s, da), R2D_MUL(d, sa));
+    }
+};
+
+struct R2DBlendTermFloatDifference {
+    static __m128 term(__m128 s, __m128 d, __m128 sa, __m128 da) noexcept {
+        __m128 diff = _mm_sub_ps(R2D_MUL(s, da), R2D_MUL(d, sa));
+        return _mm_andnot_ps(_mm_set1_ps(-0.0f), diff);
+    }
+};
+
+#undef R2D_FLOAT_OP
+#undef R2D_INV
+#undef R2D_MUL
+#undef R2D_ADD
+
+using R2DBlendFloatMultiply = R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatMultiply>>;
+using R2DBlendFloatScreen = R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatScreen>>;
+using R2DBlendFloatOverlay = R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatOverlay>>;
+using R2DBlendFloatDarken = R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatDarken>>;
+using R2DBlendFloatLighten = R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatLighten>>;
+using R2DBlendFloatDifference =
+    R2DBlendFloat<R2DBlendOpFloatSeparable<R2DBlendTermFloatDifference>>;
+
+// sRGB transfer function, `c` is in [0, 1]. x^2.4 is computed as x^2 * (x^2)^(1/5) with Newton's
+// method to keep it usable in constant expressions.
+static constexpr double r2d_srgb_decode(double c) noexcept {
+    if (c <= 0.04045)
+        return c / 12.92;
+    double x = (c + 0.055) / 1.055;
+    double x2 = x * x;
+    double root = 1.0;
+    for (int i = 0; i < 32; i++) {
+        double root2 = root * root;
+        root = (4.0 * root + x2 / (root2 * root2)) * 0.2;
+    }
+    return x2 * root;
+}
+
+// Linear light values are 12-bit fixed point in 16-bit lanes, where 4096 is one
+static constexpr uint32_t r2d_linear_one = 4096;
+
+// Expand an 8-bit alpha or coverage to 12 bits, 255 becomes 4096
+R2D_FORCEINLINE
+static constexpr uint32_t r2d_linear_alpha(uint32_t alpha) noexcept {
+    return alpha * 16 + ((alpha + 8) >> 4);
+}
+
+// Lookup tables of the sRGB transfer function used by linear light blending. Decoding maps the
+// 8-bit values to 12-bit linear values. Encoding maps linear values below one to the nearest
+// 8-bit value. `rcp` holds 2^28 / r2d_linear_alpha(a) for every 8-bit alpha `a`, it turns
+// premultiplied linear colors back into straight colors without a division.
+struct R2DSrgbTable {
+    uint16_t to_linear[256]{};
+    uint8_t from_linear[r2d_linear_one]{};
+    uint32_t rcp[256]{};
+
+    constexpr R2DSrgbTable() noexcept {
+        double midpoints[255]{};
+        for (uint32_t c = 0; c < 256; c++)
+            to_linear[c] = (uint16_t)(r2d_srgb_decode(c / 255.0) * r2d_linear_one + 0.5);
+        for (uint32_t c = 0; c < 255; c++)
+            midpoints[c] = r2d_srgb_decode((c + 0.5) / 255.0) * r2d_linear_one;
+
+        uint32_t c = 0;
+        for (uint32_t i = 0; i < r2d_linear_one; i++) {
+            while (c < 255 && midpoints[c] < i)
+                c++;
+            from_linear[i] = (uint8_t)c;
+        }
+        for (uint32_t a = 1; a < 256; a++)
+            rcp[a] = ((1u << 28) + r2d_linear_alpha(a) / 2) / r2d_linear_alpha(a);
+    }
+};
+
+inline constexpr R2DSrgbTable r2d_srgb_table{};
+
+// Multiply 12-bit linear values, exact for one. Both operands must be in [0, 4096].
+R2D_FORCEINLINE
+static __m128i r2d_linear_mul_epu16(__m128i a, __m128i b) noexcept {
+    __m128i val = _mm_mulhi_epu16(_mm_slli_epi16(a, 3), _mm_slli_epi16(b, 3));
+    return _mm_srli_epi16(_mm_add_epi16(val, _mm_set1_epi16(2)), 2);
+}
+
+// r2d_linear_alpha() on every lane
+R2D_FORCEINLINE
+static __m128i r2d_linear_alpha_epu16(__m128i alpha) noexcept {
+    __m128i round = _mm_srli_epi16(_mm_add_epi16(alpha, _mm_set1_epi16(8)), 4);
+    return _mm_add_epi16(_mm_slli_epi16(alpha, 4), round);
+}
+
+// Round 12-bit linear alpha lanes back to 8 bits, the inverse of r2d_linear_alpha_epu16()
+R2D_FORCEINLINE
+static __m128i r2d_linear_alpha8_epu16(__m128i alpha) noexcept {
+    __m128i val = _mm_mulhi_epu16(_mm_slli_epi16(alpha, 3), _mm_set1_epi16(255 << 4));
+    return _mm_srli_epi16(_mm_add_epi16(val, _mm_set1_epi16(4)), 3);
+}
+
+// Decode four straight 32-bit pixels with the channels at `bitpos` into premultiplied linear
+// light, two pixels in each of `lo` and `hi` in RGBA order. The alpha is not gamma encoded and
+// is only expanded, it is one when `Opaque` is set.
+template <bool Opaque>
+R2D_FORCEINLINE static void r2d_srgb_to_linear4(__m128i pixels, R2DColorBitShift bitpos,
+                                                __m128i& lo, __m128i& hi) noexcept {
+    alignas(16) uint32_t p[4];
+    _mm_store_si128((__m128i*)p, pixels);
+    const uint16_t* table = r2d_srgb_table.to_linear;
+    auto rg = [&](uint32_t c) {
+        return (int)(table[(c >> bitpos.r) & 0xFF] | (uint32_t)table[(c >> bitpos.g) & 0xFF] << 16);
+    };
+    auto ba = [&](uint32_t c) {
+        uint32_t alpha = Opaque ? r2d_linear_one : r2d_linear_alpha((c >> bitpos.a) & 0xFF);
+        return (int)(table[(c >> bitpos.b) & 0xFF] | alpha << 16);
+    };
+    lo = _mm_setr_epi32(rg(p[0]), ba(p[0]), rg(p[1]), ba(p[1]));
+    hi = _mm_setr_epi32(rg(p[2]), ba(p[2]), rg(p[3]), ba(p[3]));
+    if constexpr (!Opaque) {
+        lo = r2d_set_alpha_epi16(r2d_linear_mul_epu16(lo, r2d_broadcast_alpha_epi16(lo)), lo);
+        hi = r2d_set_alpha_epi16(r2d_linear_mul_epu16(hi, r2d_broadcast_alpha_epi16(hi)), hi);
+    }
+}
+
+// Encode four premultiplied linear light pixels, two in each of `lo` and `hi`, into straight
+// 32-bit pixels with the channels at `bitpos`. The colors are only clamped when `Opaque` is set,
+// which stores the premultiplied colors with an alpha of 255.
+template <bool Opaque>
+R2D_FORCEINLINE static __m128i r2d_linear_to_srgb4(__m128i lo, __m128i hi,
+                                                   R2DColorBitShift bitpos) noexcept {
+    __m128i alpha_lo = r2d_broadcast_alpha_epi16(lo);
+    __m128i alpha_hi = r2d_broadcast_alpha_epi16(hi);
+    __m128i alpha8_lo = r2d_linear_alpha8_epu16(alpha_lo);
+    __m128i alpha8_hi = r2d_linear_alpha8_epu16(alpha_hi);
+
+    __m128i one = _mm_set1_epi16((short)r2d_linear_one);
+    __m128i opaque = _mm_and_si128(_mm_cmpeq_epi16(alpha_lo, one), _mm_cmpeq_epi16(alpha_hi, one));
+    if (!Opaque && _mm_movemask_epi8(opaque) != 0xFFFF) {
+        // color * 2^28 / alpha >> 16 with the reciprocal split into 16-bit halves
+        const uint32_t* table = r2d_srgb_table.rcp;
+        auto unpremultiply = [table](__m128i color, __m128i alpha8) {
+            __m128i rcp = _mm_setr_epi32((int)table[_mm_extract_epi16(alpha8, 0)], 0,
+                                         (int)table[_mm_extract_epi16(alpha8, 4)], 0);
+            __m128i rcp_lo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rcp, 0x00), 0x00);
+            __m128i rcp_hi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rcp, 0x55), 0x55);
+            return _mm_add_epi16(_mm_mullo_epi16(color, rcp_hi), _mm_mulhi_epu16(color, rcp_lo));
+        };
+        lo = unpremultiply(lo, alpha8_lo);
+        hi = unpremultiply(hi, alpha8_hi);
+    }
+
+    __m128i max_index = _mm_set1_epi16((short)(r2d_linear_one - 1));
+    lo = r2d_set_alpha_epi16(_mm_min_epi16(_mm_max_epi16(lo, _mm_setzero_si128()), max_index),
+                             alpha8_lo);
+    hi = r2d_set_alpha_epi16(_mm_min_epi16(_mm_max_epi16(hi, _mm_setzero_si128()), max_index),
+                             alpha8_hi);
+
+    // Two lanes are moved out at once, the lookups index with each half
+    const uint8_t* table = r2d_srgb_table.from_linear;
+    auto encode = [table, bitpos](__m128i pixel) {
+        uint32_t rg = (uint32_t)_mm_cvtsi128_si32(pixel);
+        uint32_t ba = (uint32_t)_mm_cvtsi128_si32(_mm_srli_epi64(pixel, 32));
+        return (int)((uint32_t)table[rg & 0xFFFF] << bitpos.r |
+                     (uint32_t)table[rg >> 16] << bitpos.g |
+                     (uint32_t)table[ba & 0xFFFF] << bitpos.b | (ba >> 16) << bitpos.a);
+    };
+    return _mm_setr_epi32(encode(lo), encode(_mm_srli_si128(lo, 8)), encode(hi),
+                          encode(_mm_srli_si128(hi, 8)));
+}
+
+// Blend functors of linear light blending. The colors are premultiplied 12-bit linear RGBA of
+// two pixels in 16-bit lanes, every lane goes through the same formula.
+template <typename BlendOpT>
+struct R2DBlendLinear {
+    static constexpr bool fold_coverage = BlendOpT::fold_coverage;
+
+    R2D_FORCEINLINE __m128i operator()(__m128i src, __m128i dst) noexcept {
+        __m128i color = BlendOpT::blend(src, dst, r2d_broadcast_alpha_epi16(src),
+                                        r2d_broadcast_alpha_epi16(dst));
+        color = _mm_max_epi16(color, _mm_setzero_si128());
+        return _mm_min_epi16(color, _mm_set1_epi16((short)r2d_linear_one));
+    }
+};
+
+// Defines a Porter-Duff operator on premultiplied linear colors
+#define R2D_LINEAR_OP(name, fold, expr)                                                            \
+    struct R2DBlendOpLinear##name {                                                                \
+        static constexpr bool fold_coverage = fold;                                                \
+        static __m128i blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {              \
+            return expr;                                                                           \
+        }                                                                                          \
+    };                                                                                             \
+    using R2DBlendLinear##name = R2DBlendLinear<R2DBlendOpLinear##name>;
+
+#define R2D_INV(x) _mm_sub_epi16(_mm_set1_epi16((short)r2d_linear_one), x)
+#define R2D_MUL(x, y) r2d_linear_mul_epu16(x, y)
+#define R2D_ADD(x, y) _mm_add_epi16(x, y)
+
+// clang-format off
+R2D_LINEAR_OP(SrcOver, true, R2D_ADD(s, R2D_MUL(d, R2D_INV(sa))))
+R2D_LINEAR_OP(SrcAtop, true, R2D_ADD(R2D_MUL(s, da), R2D_MUL(d, R2D_INV(sa))))
+R2D_LINEAR_OP(SrcIn, false, R2D_MUL(s, da))
+R2D_LINEAR_OP(SrcOut, false, R2D_MUL(s, R2D_INV(da)))
+R2D_LINEAR_OP(SrcCopy, false, s)
+R2D_LINEAR_OP(DstOver, true, R2D_ADD(R2D_MUL(s, R2D_INV(da)), d))
+R2D_LINEAR_OP(DstAtop, false, R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, sa)))
+R2D_LINEAR_OP(DstIn, false, R2D_MUL(d, sa))
+R2D_LINEAR_OP(DstOut, true, R2D_MUL(d, R2D_INV(sa)))
+R2D_LINEAR_OP(Clear, false, _mm_setzero_si128())
+R2D_LINEAR_OP(Xor, true, R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa))))
+// clang-format on
+
+// Separable modes, see R2DBlendOpFloatSeparable
+template <typename BlendTermT>
+struct R2DBlendOpLinearSeparable {
+    static constexpr bool fold_coverage = true;
+
+    static __m128i blend(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i sum = R2D_ADD(R2D_MUL(s, R2D_INV(da)), R2D_MUL(d, R2D_INV(sa)));
+        __m128i color = R2D_ADD(sum, BlendTermT::term(s, d, sa, da));
+        return r2d_set_alpha_epi16(color, _mm_sub_epi16(R2D_ADD(sa, da), R2D_MUL(sa, da)));
+    }
+};
+
+struct R2DBlendTermLinearMultiply {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return R2D_MUL(s, d);
+    }
+};
+
+struct R2DBlendTermLinearScreen {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return _mm_sub_epi16(R2D_ADD(R2D_MUL(s, da), R2D_MUL(d, sa)), R2D_MUL(s, d));
+    }
+};
+
+struct R2DBlendTermLinearOverlay {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i zero = _mm_setzero_si128();
+        __m128i lower = _mm_slli_epi16(R2D_MUL(s, d), 1);
+        __m128i inv_d = _mm_max_epi16(_mm_sub_epi16(da, d), zero);
+        __m128i inv_s = _mm_max_epi16(_mm_sub_epi16(sa, s), zero);
+        __m128i upper = _mm_sub_epi16(R2D_MUL(sa, da), _mm_slli_epi16(R2D_MUL(inv_d, inv_s), 1));
+        __m128i is_upper = _mm_cmpgt_epi16(R2D_ADD(d, d), da);
+        return _mm_or_si128(_mm_and_si128(is_upper, upper), _mm_andnot_si128(is_upper, lower));
+    }
+};
+
+struct R2DBlendTermLinearDarken {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return _mm_min_epi16(R2D_MUL(s, da), R2D_MUL(d, sa));
+    }
+};
+
+struct R2DBlendTermLinearLighten {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        return _mm_max_epi16(R2D_MUL(s, da), R2D_MUL(d, sa));
+    }
+};
+
+struct R2DBlendTermLinearDifference {
+    static __m128i term(__m128i s, __m128i d, __m128i sa, __m128i da) noexcept {
+        __m128i x = R2D_MUL(s, da);
+        __m128i y = R2D_MUL(d, sa);
+        return _mm_sub_epi16(_mm_max_epi16(x, y), _mm_min_epi16(x, y));
+    }
+};
+
+#undef R2D_LINEAR_OP
+#undef R2D_INV
+#undef R2D_MUL
+#undef R2D_ADD
+
+using R2DBlendLinearMultiply =
+    R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearMultiply>>;
+using R2DBlendLinearScreen = R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearScreen>>;
+using R2DBlendLinearOverlay =
+    R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearOverlay>>;
+using R2DBlendLinearDarken = R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearDarken>>;
+using R2DBlendLinearLighten = R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearLighten>>;
+using R2DBlendLinearDifference =
+    R2DBlendLinear<R2DBlendOpLinearSeparable<R2DBlendTermLinearDifference>>;
+
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_src_over(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                     uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    uint32_t dst_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
-    uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
-    uint32_t src = r2d_rgb_alphamult(src_col, src_a);
-    uint32_t alpha = src_a + dst_alpha_factor;
-    // uint32_t alpha_rcp = r2d_alpharcp(ao);
-    out_alpha = alpha;
-    return r2d_rgb_alphadiv(src + dst, alpha);
+    return R2DBlendSrcOver{}(src_col, src_a, dst_col, dst_a, out_alpha);
 }
 
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_src_atop(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                     uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    uint32_t src_alpha_factor = r2d_fpmul(src_a, dst_a);
-    uint32_t dst_alpha_factor = r2d_fpmul(dst_a, 255 - src_a);
-    uint32_t src = r2d_rgb_alphamult(src_col, src_alpha_factor);
-    uint32_t dst = r2d_rgb_alphamult(dst_col, dst_alpha_factor);
-    uint32_t alpha = src_alpha_factor + dst_alpha_factor;
-    out_alpha = alpha;
-    return r2d_rgb_alphadiv(src + dst, alpha);
+    return R2DBlendSrcAtop{}(src_col, src_a, dst_col, dst_a, out_alpha);
 }
 
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_src_in(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                   uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    return 0;
+    return R2DBlendSrcIn{}(src_col, src_a, dst_col, dst_a, out_alpha);
 }
 
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_src_out(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                    uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    return 0;
+    return R2DBlendSrcOut{}(src_col, src_a, dst_col, dst_a, out_alpha);
 }
 
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_src_copy(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                     uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    return 0;
+    return R2DBlendSrcCopy{}(src_col, src_a, dst_col, dst_a, out_alpha);
 }
 
 R2D_FORCEINLINE
 static R2DColor8 r2d_blend_dst_over(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
                                     uint32_t dst_a, uint32_t& out_alpha) noexcept {
-    return 0;
-}
\ No newline at end of file
+    return R2DBlendDstOver{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_dst_atop(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                    uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDstAtop{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_dst_in(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                  uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDstIn{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_dst_out(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                   uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDstOut{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_dst_copy(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                    uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDstCopy{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_clear(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                 uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendClear{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_xor(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                               uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendXor{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_multiply(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                    uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendMultiply{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_screen(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                  uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendScreen{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_overlay(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                   uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendOverlay{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_darken(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                  uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDarken{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_lighten(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                   uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendLighten{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
+
+R2D_FORCEINLINE
+static R2DColor8 r2d_blend_difference(R2DColor8 src_col, uint32_t src_a, R2DColor8 dst_col,
+                                      uint32_t dst_a, uint32_t& out_alpha) noexcept {
+    return R2DBlendDifference{}(src_col, src_a, dst_col, dst_a, out_alpha);
+}
@@ -43,7 +43,7 @@ static void r2d_copy_image_gdi(HDC hdc, const RECT& dst, const R2DImage& src_ima
     // We use BITMAPV4HEADER so that we can have the color mask field
     BITMAPV4HEADER bmi{};
     bmi.bV4Size = sizeof(BITMAPINFOHEADER);
-    bmi.bV4Width = src_image.width_;
+    bmi.bV4Width = (LONG)(src_image.stride_ / 4);
     bmi.bV4Height = src_image.height_;
     bmi.bV4Planes = 1;
     bmi.bV4BitCount = 32;
@@ -64,7 +64,7 @@ static void r2d_blit_image_gdi(HDC hdc, const RECT& dst, const R2DImage& src_ima
 
     BITMAPV4HEADER bmi{};
     bmi.bV4Size = sizeof(BITMAPINFOHEADER);
-    bmi.bV4Width = src_image.width_;
+    bmi.bV4Width = (LONG)(src_image.stride_ / 4);
     bmi.bV4Height = src_image.height_;
     bmi.bV4Planes = 1;
     bmi.bV4BitCount = 32;
@@ -95,40 +95,63 @@ static void r2d_copy_image_d3d11() {
 }
 
 #ifdef R2D_SURFACE_SDL2
+// Pixel format of a surface that images can use to render into it directly, Unknown if it has
+// no matching 32-bit format
+static R2DPixelFormat r2d_sdl2_surface_format(const SDL_PixelFormat* format) {
+    if (format->BytesPerPixel != 4)
+        return R2DPixelFormat::Unknown;
+    static constexpr R2DPixelFormat formats[] = {
+        R2DPixelFormat::RGBA8, R2DPixelFormat::ARGB8, R2DPixelFormat::BGRA8,
+        R2DPixelFormat::RGBX8, R2DPixelFormat::BGRX8,
+    };
+    bool has_alpha = format->Amask != 0;
+    for (R2DPixelFormat pixel_format : formats) {
+        if (r2d_format_has_alpha(pixel_format) != has_alpha)
+            continue;
+        R2DColorBitShift bitpos = r2d_color_bitshift(pixel_format);
+        if (bitpos.r == format->Rshift && bitpos.g == format->Gshift &&
+            bitpos.b == format->Bshift && (!has_alpha || bitpos.a == format->Ashift))
+            return pixel_format;
+    }
+    return R2DPixelFormat::Unknown;
+}
+
 static void r2d_sdl2_render_blit_image(SDL_Surface* dst_surface, const R2DImage& src_image,
                                        bool update_window) {
     assert(dst_surface->w == src_image.width_);
     assert(dst_surface->h == src_image.height_);
-    auto pixels = (R2DColor8*)dst_surface->pixels;
-    uint32_t r_shift = dst_surface->format->Rshift;
-    uint32_t g_shift = dst_surface->format->Gshift;
-    uint32_t b_shift = dst_surface->format->Bshift;
-    uint32_t a_shift = dst_surface->format->Ashift;
-    uint32_t a_mask = dst_surface->format->Ashift;
-    R2DColorBitShift src_bitshift = r2d_color_bitshift(src_image.format_);
-    uint32_t src_color_shift = 24 - src_bitshift.a;
-    R2DColor8* src_color = (R2DColor8*)src_image.raw_data();
-
-    if (a_mask == 0) {
-        for (int i = 0; i < dst_surface->w * dst_surface->h; i++) {
-            uint32_t col = src_color[i];
-            uint32_t rgb = (col >> src_color_shift) & 0x00FFFFFF;
-            uint32_t premul = r2d_rgb_alphamult(rgb, (col >> src_bitshift.a) & 0xFF);
-            uint32_t src_r = (premul >> src_bitshift.r) & 0xFF;
-            uint32_t src_g = (premul >> src_bitshift.g) & 0xFF;
-            uint32_t src_b = (premul >> src_bitshift.b) & 0xFF;
-            pixels[i] = (src_r << r_shift) | (src_g << g_shift) | (src_b << b_shift);
-        }
-    } else {
-        for (int i = 0; i < dst_surface->w * dst_surface->h; i++) {
-            uint32_t col = src_color[i];
-            uint32_t src_r = (col >> src_bitshift.r) & 0xFF;
-            uint32_t src_g = (col >> src_bitshift.g) & 0xFF;
-            uint32_t src_b = (col >> src_bitshift.b) & 0xFF;
-            uint32_t src_a = (col >> src_bitshift.a) & 0xFF;
-            pixels[i] =
-                (src_r << r_shift) | (src_g << g_shift) | (src_b << b_shift) | (src_a << a_shift);
-        }
+    assert(dst_surface->format->BytesPerPixel == 4);
+    // Nothing to do for images that wrap the surface pixels
+    if (src_image.raw_data() == dst_surface->pixels)
+        return;
+    const SDL_PixelFormat* format = dst_surface->format;
+    bool has_alpha = format->Amask != 0;
+
+    // The format converter does not read NV12, such images go through an RGBA8 copy
+    const R2DImage* image = &src_image;
+    R2DImage staging;
+    if (src_image.format_ == R2DPixelFormat::NV12) {
+        if (!staging.init(src_image.width_, src_image.height_, R2DPixelFormat::RGBA8))
+            return;
+        r2d_convert_image(staging, src_image);
+        image = &staging;
     }
+
+    // Surfaces without alpha show the image composited over black
+    R2DFormatConverter converter(has_alpha ? R2DPixelFormat::RGBA8 : R2DPixelFormat::RGBX8,
+                                 image->format_,
+                                 has_alpha ? R2DAlphaConversion::None
+                                           : R2DAlphaConversion::Premultiply);
+    converter.dst_bitshift.r = format->Rshift;
+    converter.dst_bitshift.g = format->Gshift;
+    converter.dst_bitshift.b = format->Bshift;
+    // The unused byte takes the remaining position
+    converter.dst_bitshift.a =
+        has_alpha ? format->Ashift : 48 - format->Rshift - format->Gshift - format->Bshift;
+
+    auto dst_pixels = (uint8_t*)dst_surface->pixels;
+    for (int y = 0; y < dst_surface->h; y++)
+        converter.convert_row(dst_pixels + (size_t)y * dst_surface->pitch, image->row(y),
+                              dst_surface->w);
 }
-#endif
\ No newline at end of file
+#endif